@@ -0,0 +1,344 @@
+/*******************************************************************************
+ * Copyright (c) 2013-2014, Julien Bigot - CEA (julien.bigot@cea.fr)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+/* Measures how long ah5 blocks the caller compared to plain synchronous HDF5
+ * writes, for a sweep of array sizes, ranks, layouts, variable counts, element
+ * types and copy modes. One line of results is printed per configuration, as
+ * CSV (the default) or as JSON.
+ *
+ * usage: ah5_bench [--full] [--json] [--steps N] [--dir DIR]
+ *   --full   sweep the cartesian product of all parameters instead of varying
+ *            one parameter at a time around the baseline
+ *   --json   print a JSON array instead of CSV
+ *   --steps  number of snapshots written per configuration (3 by default)
+ *   --dir    directory where to write the files (. by default)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <ah5.h>
+
+/** the maximum rank supported by ah5 */
+#define BENCH_MAX_RANK 7
+
+/** the baseline configuration */
+#define BASE_TYPE 3
+#define BASE_RANK 2
+#define BASE_SIZE 1
+#define BASE_STRIDED 0
+#define BASE_VARS 0
+#define BASE_PARACOPY 1
+
+typedef struct {
+	const char* name;
+	hid_t type;
+} bench_type_t;
+
+typedef struct {
+	int type;
+	int rank;
+	int size;
+	int strided;
+	int vars;
+	int paracopy;
+} bench_config_t;
+
+typedef struct {
+	double blocked_us;
+	double sync_us;
+	double copy_gbps;
+	double write_gbps;
+	double overlap;
+} bench_result_t;
+
+static bench_type_t TYPES[] = {
+	{ "char", 0 }, { "short", 0 }, { "float", 0 }, { "double", 0 }
+};
+#define NB_TYPES ((int)(sizeof(TYPES)/sizeof(TYPES[0])))
+
+/** the total number of bytes written per snapshot */
+static const size_t SIZES[] = { 1<<20, 16<<20, 64<<20 };
+#define NB_SIZES ((int)(sizeof(SIZES)/sizeof(SIZES[0])))
+
+/** the number of variables the bytes are split into */
+static const int VARS[] = { 1, 16, 256 };
+#define NB_VARS ((int)(sizeof(VARS)/sizeof(VARS[0])))
+
+static int nb_steps = 3;
+static int json = 0;
+static const char* dir = ".";
+static int nb_printed = 0;
+
+static double now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e6 + ts.tv_nsec*1e-3;
+}
+
+/** Computes the dimensions of the written part of a variable of a given number
+ * of elements, as close to a hypercube as possible
+ */
+static void part_dims( size_t nb_elems, int rank, hsize_t* count )
+{
+	hsize_t side = 1;
+	hsize_t inner = 1;
+	int dim;
+	while ( rank > 1 ) {
+		hsize_t next = side+1;
+		hsize_t volume = 1;
+		for ( dim = 0; dim<rank; ++dim ) volume *= next;
+		if ( volume > nb_elems ) break;
+		side = next;
+	}
+	for ( dim = 1; dim<rank; ++dim ) {
+		count[dim] = side;
+		inner *= side;
+	}
+	count[0] = nb_elems / inner;
+	if ( count[0] < 1 ) count[0] = 1;
+}
+
+/** Computes the array dimensions and the bounds of the written part, strided
+ * layouts write the inside of an array with a margin in the first and last
+ * dimensions
+ */
+static void part_layout( const bench_config_t* config, hsize_t* count, hsize_t* dims,
+		hsize_t* lbounds, hsize_t* ubounds, size_t* nb_elems )
+{
+	size_t type_size = H5Tget_size(TYPES[config->type].type);
+	int dim;
+	part_dims(SIZES[config->size] / type_size / VARS[config->vars], config->rank, count);
+	*nb_elems = 1;
+	for ( dim = 0; dim<config->rank; ++dim ) {
+		int margin = config->strided && ( dim == 0 || dim == config->rank-1 );
+		lbounds[dim] = margin;
+		ubounds[dim] = margin+count[dim];
+		dims[dim] = count[dim]+2*margin;
+		*nb_elems *= dims[dim];
+	}
+}
+
+/** Writes the variables with plain synchronous HDF5 calls
+ * @returns the duration in microseconds
+ */
+static double run_sync( const bench_config_t* config, void** bufs, const char* file_name )
+{
+	hsize_t count[BENCH_MAX_RANK], dims[BENCH_MAX_RANK], lbounds[BENCH_MAX_RANK], ubounds[BENCH_MAX_RANK];
+	hid_t type = TYPES[config->type].type;
+	size_t nb_elems;
+	double start = now_us();
+	hid_t file_id;
+	int var;
+	part_layout(config, count, dims, lbounds, ubounds, &nb_elems);
+	file_id = H5Fcreate(file_name, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	for ( var = 0; var<VARS[config->vars]; ++var ) {
+		char name[32];
+		hid_t space_id = H5Screate_simple(config->rank, count, NULL);
+		hid_t mem_space_id = H5Screate_simple(config->rank, dims, NULL);
+		hid_t dset_id;
+		sprintf(name, "var%d", var);
+		dset_id = H5Dcreate2(file_id, name, type, space_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+		H5Sselect_hyperslab(mem_space_id, H5S_SELECT_SET, lbounds, NULL, count, NULL);
+		H5Dwrite(dset_id, type, mem_space_id, H5S_ALL, H5P_DEFAULT, bufs[var]);
+		H5Dclose(dset_id);
+		H5Sclose(mem_space_id);
+		H5Sclose(space_id);
+	}
+	H5Fclose(file_id);
+	return now_us()-start;
+}
+
+/** Writes the variables with ah5, each snapshot fully written before the next
+ * one, as if the computation between snapshots hid the writing
+ */
+static void run_async( const bench_config_t* config, void** bufs, const char* file_name,
+		bench_result_t* result )
+{
+	hsize_t count[BENCH_MAX_RANK], dims[BENCH_MAX_RANK], lbounds[BENCH_MAX_RANK], ubounds[BENCH_MAX_RANK];
+	hid_t type = TYPES[config->type].type;
+	ah5_stats_t stats;
+	ah5_t ah5;
+	size_t nb_elems;
+	int step, var;
+	part_layout(config, count, dims, lbounds, ubounds, &nb_elems);
+	ah5_init(&ah5);
+	ah5_set_depth(ah5, 2);
+	ah5_set_paracopy(ah5, config->paracopy);
+	for ( step = 0; step<nb_steps; ++step ) {
+		ah5_token_t token;
+		ah5_start(ah5, (char*)file_name);
+		for ( var = 0; var<VARS[config->vars]; ++var ) {
+			char name[32];
+			sprintf(name, "var%d", var);
+			ah5_write(ah5, bufs[var], name, type, config->rank, dims, lbounds, ubounds);
+		}
+		ah5_get_listtoken(ah5, &token);
+		ah5_finish(ah5);
+		ah5_token_wait(ah5, token);
+	}
+	ah5_get_stats(ah5, &stats, NULL);
+	ah5_finalize(ah5);
+	result->blocked_us = (double)stats.blocked_us / nb_steps;
+	result->copy_gbps = stats.copy_bandwidth*1e-9;
+	result->write_gbps = stats.write_bandwidth*1e-9;
+	result->overlap = stats.overlap;
+}
+
+static void print_result( const bench_config_t* config, const bench_result_t* result )
+{
+	hsize_t count[BENCH_MAX_RANK], dims[BENCH_MAX_RANK], lbounds[BENCH_MAX_RANK], ubounds[BENCH_MAX_RANK];
+	char shape[256] = "";
+	size_t nb_elems;
+	int dim;
+	part_layout(config, count, dims, lbounds, ubounds, &nb_elems);
+	for ( dim = 0; dim<config->rank; ++dim ) {
+		sprintf(shape+strlen(shape), "%s%llu", dim? "x" : "", (unsigned long long)count[dim]);
+	}
+	if ( json ) {
+		printf("%s\n  {\"type\": \"%s\", \"rank\": %d, \"shape\": \"%s\", \"layout\": \"%s\", "
+				"\"vars\": %d, \"paracopy\": %d, \"bytes\": %lu, \"blocked_us\": %.1f, "
+				"\"sync_us\": %.1f, \"copy_gbps\": %.3f, \"write_gbps\": %.3f, \"overlap\": %.3f, "
+				"\"speedup\": %.2f}",
+				nb_printed? "," : "[", TYPES[config->type].name, config->rank, shape,
+				config->strided? "strided" : "contiguous", VARS[config->vars], config->paracopy,
+				(unsigned long)SIZES[config->size], result->blocked_us, result->sync_us,
+				result->copy_gbps, result->write_gbps, result->overlap,
+				result->sync_us/result->blocked_us);
+	} else {
+		if ( !nb_printed ) {
+			printf("type,rank,shape,layout,vars,paracopy,bytes,blocked_us,sync_us,copy_gbps,"
+					"write_gbps,overlap,speedup\n");
+		}
+		printf("%s,%d,%s,%s,%d,%d,%lu,%.1f,%.1f,%.3f,%.3f,%.3f,%.2f\n", TYPES[config->type].name,
+				config->rank, shape, config->strided? "strided" : "contiguous",
+				VARS[config->vars], config->paracopy, (unsigned long)SIZES[config->size],
+				result->blocked_us, result->sync_us, result->copy_gbps, result->write_gbps,
+				result->overlap, result->sync_us/result->blocked_us);
+	}
+	fflush(stdout);
+	++nb_printed;
+}
+
+static void run_config( const bench_config_t* config )
+{
+	hsize_t count[BENCH_MAX_RANK], dims[BENCH_MAX_RANK], lbounds[BENCH_MAX_RANK], ubounds[BENCH_MAX_RANK];
+	size_t type_size = H5Tget_size(TYPES[config->type].type);
+	char file_name[4096];
+	bench_result_t result;
+	void** bufs = malloc(VARS[config->vars]*sizeof(void*));
+	size_t nb_elems;
+	int step, var;
+	part_layout(config, count, dims, lbounds, ubounds, &nb_elems);
+	for ( var = 0; var<VARS[config->vars]; ++var ) {
+		bufs[var] = malloc(nb_elems*type_size);
+		/* touch the pages so that their first use is not measured */
+		memset(bufs[var], var, nb_elems*type_size);
+	}
+	snprintf(file_name, sizeof(file_name), "%s/ah5_bench_sync.h5", dir);
+	result.sync_us = 0;
+	for ( step = 0; step<nb_steps; ++step ) {
+		result.sync_us += run_sync(config, bufs, file_name) / nb_steps;
+	}
+	unlink(file_name);
+	snprintf(file_name, sizeof(file_name), "%s/ah5_bench.h5", dir);
+	run_async(config, bufs, file_name, &result);
+	unlink(file_name);
+	print_result(config, &result);
+	for ( var = 0; var<VARS[config->vars]; ++var ) free(bufs[var]);
+	free(bufs);
+}
+
+int main( int argc, char** argv )
+{
+	bench_config_t config;
+	int full = 0;
+	int ii;
+	for ( ii = 1; ii<argc; ++ii ) {
+		if ( !strcmp(argv[ii], "--full") ) {
+			full = 1;
+		} else if ( !strcmp(argv[ii], "--json") ) {
+			json = 1;
+		} else if ( !strcmp(argv[ii], "--steps") && ii+1<argc ) {
+			nb_steps = atoi(argv[++ii]);
+			if ( nb_steps < 1 ) nb_steps = 1;
+		} else if ( !strcmp(argv[ii], "--dir") && ii+1<argc ) {
+			dir = argv[++ii];
+		} else {
+			fprintf(stderr, "usage: %s [--full] [--json] [--steps N] [--dir DIR]\n", argv[0]);
+			return 1;
+		}
+	}
+	H5open();
+	TYPES[0].type = H5T_NATIVE_CHAR;
+	TYPES[1].type = H5T_NATIVE_SHORT;
+	TYPES[2].type = H5T_NATIVE_FLOAT;
+	TYPES[3].type = H5T_NATIVE_DOUBLE;
+
+	if ( full ) {
+		for ( config.type = 0; config.type<NB_TYPES; ++config.type )
+		for ( config.rank = 1; config.rank<=BENCH_MAX_RANK; ++config.rank )
+		for ( config.size = 0; config.size<NB_SIZES; ++config.size )
+		for ( config.strided = 0; config.strided<2; ++config.strided )
+		for ( config.vars = 0; config.vars<NB_VARS; ++config.vars )
+		for ( config.paracopy = 0; config.paracopy<2; ++config.paracopy ) {
+			run_config(&config);
+		}
+	} else {
+		/* vary one parameter at a time around the baseline */
+		const bench_config_t base = { BASE_TYPE, BASE_RANK, BASE_SIZE, BASE_STRIDED, BASE_VARS,
+				BASE_PARACOPY };
+		config = base;
+		run_config(&config);
+		for ( config.type = 0; config.type<NB_TYPES; ++config.type ) {
+			if ( config.type != base.type ) run_config(&config);
+		}
+		config = base;
+		for ( config.rank = 1; config.rank<=BENCH_MAX_RANK; ++config.rank ) {
+			if ( config.rank != base.rank ) run_config(&config);
+		}
+		config = base;
+		for ( config.size = 0; config.size<NB_SIZES; ++config.size ) {
+			if ( config.size != base.size ) run_config(&config);
+		}
+		config = base;
+		config.strided = !base.strided;
+		run_config(&config);
+		config = base;
+		for ( config.vars = 0; config.vars<NB_VARS; ++config.vars ) {
+			if ( config.vars != base.vars ) run_config(&config);
+		}
+		config = base;
+		config.paracopy = !base.paracopy;
+		run_config(&config);
+	}
+	if ( json ) printf("%s]\n", nb_printed? "\n" : "[");
+	return 0;
+}
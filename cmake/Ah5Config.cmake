@@ -26,9 +26,7 @@ include(CMakeFindDependencyMacro)
 list(INSERT CMAKE_MODULE_PATH 0 "${CMAKE_CURRENT_LIST_DIR}")
 
 find_dependency(HDF5)
-if("${BUILD_OPENMP}")
-	find_package(OMP REQUIRED)
-endif()
+find_dependency(Threads)
 
 # by default, if no component is specified, look for all
 if("xx" STREQUAL "x${Ah5_FIND_COMPONENTS}x")
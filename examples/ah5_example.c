@@ -68,6 +68,7 @@ int main(int argc, char** argv)
 
 
 	ah5_init(&ah5_inst);
+	ah5_set_depth(ah5_inst, 2);
 	data = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
 	data_init(data);
 	data_next = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
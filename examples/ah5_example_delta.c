@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * Copyright (c) 2013-2014, Julien Bigot - CEA (julien.bigot@cea.fr)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ah5.h>
+
+#define DATA_HEIGHT 512
+#define DATA_WIDTH 256
+
+int data_check(char *fname, double *data, int linked)
+{
+	double *read = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	int ii, nb_errors = 0;
+	hid_t file_id, dset_id;
+	H5L_info_t link_info;
+
+	file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+	if ( H5Lget_info(file_id, "data", &link_info, H5P_DEFAULT) < 0
+			|| (link_info.type == H5L_TYPE_EXTERNAL) != linked ) {
+		fprintf(stderr, "%s: data is %san external link\n", fname, linked? "not " : "");
+		++nb_errors;
+	}
+	dset_id = H5Dopen2(file_id, "data", H5P_DEFAULT);
+	if ( H5Dread(dset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, read) < 0 ) ++nb_errors;
+	H5Dclose(dset_id);
+	H5Fclose(file_id);
+	for (ii=0; ii<DATA_WIDTH*DATA_HEIGHT; ++ii) {
+		if ( read[ii] != data[ii] ) ++nb_errors;
+	}
+	if ( nb_errors ) fprintf(stderr, "%s: %d errors\n", fname, nb_errors);
+	free(read);
+	return nb_errors;
+}
+
+int main(void)
+{
+	ah5_t ah5_inst;
+	double *data, *first;
+	int ii, done, nb_errors = 0;
+	char fname[32];
+	hsize_t zsize[2] = {0, 0};
+	hsize_t bounds[2] = { DATA_HEIGHT, DATA_WIDTH };
+
+
+	ah5_init(&ah5_inst);
+	ah5_set_delta(ah5_inst, 1);
+	data = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	first = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	for (ii=0; ii<DATA_WIDTH*DATA_HEIGHT; ++ii) first[ii] = data[ii] = ii;
+
+	/* the data does not change between the two files */
+	for (ii=0; ii<2; ++ii) {
+		sprintf(fname, "delta.%d.h5", ii);
+		ah5_start(ah5_inst, fname);
+		ah5_write(ah5_inst, data, "data", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds );
+		ah5_finish(ah5_inst);
+	}
+	ah5_wait(ah5_inst, -1, &done);
+
+	/* the second file only links to the dataset of the first one */
+	nb_errors += data_check("delta.1.h5", first, 1);
+
+	/* like alternating restart files, the first file is then overwritten with
+	 * new data, the second one must keep the data it was written with */
+	for (ii=0; ii<DATA_WIDTH*DATA_HEIGHT; ++ii) data[ii] = -ii;
+	ah5_start(ah5_inst, "delta.0.h5");
+	ah5_write(ah5_inst, data, "data", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds );
+	ah5_finish(ah5_inst);
+	ah5_finalize(ah5_inst);
+
+	nb_errors += data_check("delta.0.h5", data, 0);
+	nb_errors += data_check("delta.1.h5", first, 0);
+
+	free(data);
+	free(first);
+	return nb_errors != 0;
+}
@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * Copyright (c) 2013-2014, Julien Bigot - CEA (julien.bigot@cea.fr)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ah5.h>
+
+#define DATA_HEIGHT 200
+#define DATA_WIDTH 150
+#define SCALE .5
+#define OFFSET 100.
+
+double attr_read(hid_t dset_id, const char *name)
+{
+	double value = 0;
+	hid_t attr_id = H5Aopen(dset_id, name, H5P_DEFAULT);
+	if ( attr_id < 0 ) return 0;
+	H5Aread(attr_id, H5T_NATIVE_DOUBLE, &value);
+	H5Aclose(attr_id);
+	return value;
+}
+
+int main(void)
+{
+	ah5_t ah5_inst;
+	double *data;
+	short *packed;
+	float *single;
+	int ii, nb_errors = 0;
+	hid_t file_id, dset_id, type_id;
+	hsize_t zsize[2] = {0, 0};
+	hsize_t bounds[2] = { DATA_HEIGHT, DATA_WIDTH };
+
+
+	ah5_init(&ah5_inst);
+	data = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	packed = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(short));
+	single = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(float));
+	/* values exactly representable once packed */
+	for (ii=0; ii<DATA_WIDTH*DATA_HEIGHT; ++ii) {
+		data[ii] = OFFSET + SCALE*(ii%20000-10000);
+	}
+
+	ah5_start(ah5_inst, "filetype.h5");
+	/* packed as short with the CF conventions */
+	ah5_set_filetype(ah5_inst, H5T_NATIVE_SHORT, SCALE, OFFSET);
+	ah5_write(ah5_inst, data, "packed", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds );
+	/* in single precision */
+	ah5_set_filetype(ah5_inst, H5T_NATIVE_FLOAT, 1, 0);
+	ah5_write(ah5_inst, data, "single", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds );
+	/* with its own type */
+	ah5_set_filetype(ah5_inst, -1, 1, 0);
+	ah5_write(ah5_inst, data, "double", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds );
+	ah5_finish(ah5_inst);
+	ah5_finalize(ah5_inst);
+
+	file_id = H5Fopen("filetype.h5", H5F_ACC_RDONLY, H5P_DEFAULT);
+	dset_id = H5Dopen2(file_id, "packed", H5P_DEFAULT);
+	type_id = H5Dget_type(dset_id);
+	if ( H5Tget_class(type_id) != H5T_INTEGER || H5Tget_size(type_id) != sizeof(short) ) {
+		fprintf(stderr, "filetype.h5: packed is not stored as short\n");
+		++nb_errors;
+	}
+	H5Tclose(type_id);
+	if ( attr_read(dset_id, "scale_factor") != SCALE || attr_read(dset_id, "add_offset") != OFFSET ) {
+		fprintf(stderr, "filetype.h5: wrong packing attributes\n");
+		++nb_errors;
+	}
+	if ( H5Dread(dset_id, H5T_NATIVE_SHORT, H5S_ALL, H5S_ALL, H5P_DEFAULT, packed) < 0 ) ++nb_errors;
+	H5Dclose(dset_id);
+	dset_id = H5Dopen2(file_id, "single", H5P_DEFAULT);
+	type_id = H5Dget_type(dset_id);
+	if ( H5Tget_class(type_id) != H5T_FLOAT || H5Tget_size(type_id) != sizeof(float) ) {
+		fprintf(stderr, "filetype.h5: single is not stored as float\n");
+		++nb_errors;
+	}
+	H5Tclose(type_id);
+	if ( H5Dread(dset_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, single) < 0 ) ++nb_errors;
+	H5Dclose(dset_id);
+	dset_id = H5Dopen2(file_id, "double", H5P_DEFAULT);
+	type_id = H5Dget_type(dset_id);
+	if ( H5Tget_size(type_id) != sizeof(double) ) {
+		fprintf(stderr, "filetype.h5: double is not stored as double\n");
+		++nb_errors;
+	}
+	H5Tclose(type_id);
+	H5Dclose(dset_id);
+	H5Fclose(file_id);
+	for (ii=0; ii<DATA_WIDTH*DATA_HEIGHT; ++ii) {
+		if ( packed[ii]*SCALE+OFFSET != data[ii] ) ++nb_errors;
+		if ( single[ii] != (float)data[ii] ) ++nb_errors;
+	}
+
+	if ( nb_errors ) fprintf(stderr, "filetype.h5: %d errors\n", nb_errors);
+	free(data);
+	free(packed);
+	free(single);
+	return nb_errors != 0;
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * Copyright (c) 2013-2014, Julien Bigot - CEA (julien.bigot@cea.fr)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ah5.h>
+
+#define DATA_HEIGHT 512
+#define DATA_WIDTH 256
+#define VALUE(yy, xx) ((yy)*1000. + (xx))
+
+int main(void)
+{
+	ah5_t ah5_inst;
+	ah5_token_t list_token, full_token, part_token;
+	double *data, *loaded, *part;
+	int yy, xx, nb_errors = 0;
+	hsize_t zsize[2] = {0, 0};
+	hsize_t bounds[2] = { DATA_HEIGHT, DATA_WIDTH };
+	hsize_t part_bounds[2] = { DATA_HEIGHT/4, DATA_WIDTH/4 };
+	hsize_t part_offset[2] = { DATA_HEIGHT/2, DATA_WIDTH/2 };
+
+
+	ah5_init(&ah5_inst);
+	ah5_set_depth(ah5_inst, 2);
+	data = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	loaded = calloc(DATA_WIDTH*DATA_HEIGHT, sizeof(double));
+	for (yy=0; yy<DATA_HEIGHT; ++yy) {
+		for (xx=0; xx<DATA_WIDTH; ++xx) {
+			data[xx+yy*DATA_WIDTH] = VALUE(yy, xx);
+		}
+	}
+
+	ah5_start(ah5_inst, "load.h5");
+	ah5_write(ah5_inst, data, "data", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds );
+	ah5_finish(ah5_inst);
+
+	/* the load is ordered after the write of the same file */
+	ah5_load_start(ah5_inst, "load.h5");
+	ah5_get_listtoken(ah5_inst, &list_token);
+	ah5_load(ah5_inst, loaded, "data", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds, NULL);
+	ah5_get_vartoken(ah5_inst, &full_token);
+	/* a part of the dataset, loaded in the staging buffer */
+	ah5_load(ah5_inst, NULL, "data", H5T_NATIVE_DOUBLE, 2, bounds, zsize, part_bounds,
+			part_offset);
+	ah5_get_vartoken(ah5_inst, &part_token);
+	ah5_load_finish(ah5_inst);
+
+	if ( ah5_load_data(ah5_inst, full_token, (void**)&part) || part != loaded ) ++nb_errors;
+	for (yy=0; yy<DATA_HEIGHT; ++yy) {
+		for (xx=0; xx<DATA_WIDTH; ++xx) {
+			if ( loaded[xx+yy*DATA_WIDTH] != VALUE(yy, xx) ) ++nb_errors;
+		}
+	}
+	if ( ah5_load_data(ah5_inst, part_token, (void**)&part) ) return 1;
+	for (yy=0; yy<DATA_HEIGHT/4; ++yy) {
+		for (xx=0; xx<DATA_WIDTH/4; ++xx) {
+			if ( part[xx+yy*(DATA_WIDTH/4)] != VALUE(yy+DATA_HEIGHT/2, xx+DATA_WIDTH/2) ) ++nb_errors;
+		}
+	}
+	ah5_load_release(ah5_inst, list_token);
+
+	ah5_finalize(ah5_inst);
+	if ( nb_errors ) fprintf(stderr, "load.h5: %d errors\n", nb_errors);
+	free(data);
+	free(loaded);
+	return nb_errors != 0;
+}
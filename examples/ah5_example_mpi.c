@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2013-2014, Julien Bigot - CEA (julien.bigot@cea.fr)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+#include <ah5.h>
+
+#define DATA_HEIGHT 2048
+#define DATA_WIDTH 512
+
+void data_init(double *data, int height, int first_row)
+{
+	int xx, yy;
+	for (yy=0; yy<height; ++yy) {
+		for (xx=0; xx<DATA_WIDTH; ++xx) {
+			data[xx+yy*DATA_WIDTH] = sin((1.*xx)/DATA_WIDTH)*sin((1.*(yy+first_row))/DATA_HEIGHT);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ah5_t ah5_inst;
+	double *data;
+	int ii, provided, rank, size, first_row, height;
+	char fname[15];
+	hsize_t zsize[2] = {0, 0};
+	hsize_t bounds[2] = { 0, DATA_WIDTH };
+	hsize_t global_dims[2] = { DATA_HEIGHT, DATA_WIDTH };
+	hsize_t offset[2] = { 0, 0 };
+
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+	/* each process owns a band of rows of the shared dataset */
+	first_row = DATA_HEIGHT*rank/size;
+	height = DATA_HEIGHT*(rank+1)/size - first_row;
+	bounds[0] = height;
+	offset[0] = first_row;
+
+	if ( ah5_init_mpi(&ah5_inst, MPI_COMM_WORLD) ) MPI_Abort(MPI_COMM_WORLD, 1);
+	data = malloc(DATA_WIDTH*height*sizeof(double));
+	data_init(data, height, first_row);
+
+	for (ii=0; ii<100; ii+=10) {
+		sprintf(fname, "data.%d.h5", ii);
+		ah5_start(ah5_inst, fname);
+		ah5_write_global(ah5_inst, data, "data", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds,
+				global_dims, offset);
+		ah5_finish(ah5_inst);
+	}
+
+	ah5_finalize(ah5_inst);
+	free(data);
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright (c) 2013-2014, Julien Bigot - CEA (julien.bigot@cea.fr)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ah5.h>
+
+#define DATA_HEIGHT 256
+#define DATA_WIDTH 128
+#define NB_STEPS 4
+
+void data_init(double *data, int step)
+{
+	int xx, yy;
+	for (yy=0; yy<DATA_HEIGHT; ++yy) {
+		for (xx=0; xx<DATA_WIDTH; ++xx) {
+			data[xx+yy*DATA_WIDTH] = step*1000. + yy + xx/1000.;
+		}
+	}
+}
+
+int data_check(char *fname, int step)
+{
+	double *data = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	double *ref = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	int file_step = -1;
+	int ii, nb_errors = 0;
+	hid_t file_id, dset_id;
+
+	data_init(ref, step);
+	file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+	dset_id = H5Dopen2(file_id, "data", H5P_DEFAULT);
+	if ( H5Dread(dset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) < 0 ) ++nb_errors;
+	H5Dclose(dset_id);
+	dset_id = H5Dopen2(file_id, "step", H5P_DEFAULT);
+	if ( H5Dread(dset_id, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &file_step) < 0 ) ++nb_errors;
+	H5Dclose(dset_id);
+	H5Fclose(file_id);
+
+	if ( file_step != step ) ++nb_errors;
+	for (ii=0; ii<DATA_WIDTH*DATA_HEIGHT; ++ii) {
+		if ( data[ii] != ref[ii] ) ++nb_errors;
+	}
+	if ( nb_errors ) fprintf(stderr, "%s: %d errors\n", fname, nb_errors);
+	free(data);
+	free(ref);
+	return nb_errors;
+}
+
+int main(void)
+{
+	ah5_t ah5_inst;
+	ah5_plan_t plan;
+	double *data[2];
+	int steps[2];
+	void *arrays[2];
+	int ii, nb_errors = 0;
+	char fname[32];
+	hsize_t zsize[2] = {0, 0};
+	hsize_t bounds[2] = { DATA_HEIGHT, DATA_WIDTH };
+
+
+	ah5_init(&ah5_inst);
+	ah5_set_depth(ah5_inst, 2);
+	data[0] = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	data[1] = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+
+	/* the first step records the plan */
+	data_init(data[0], 0);
+	steps[0] = 0;
+	ah5_start(ah5_inst, "plan.0.h5");
+	ah5_write(ah5_inst, data[0], "data", H5T_NATIVE_DOUBLE, 2, bounds, zsize, bounds );
+	ah5_write(ah5_inst, &steps[0], "step", H5T_NATIVE_INT, 0, NULL, NULL, NULL );
+	if ( ah5_plan_save(ah5_inst, &plan) ) return 1;
+	ah5_finish(ah5_inst);
+
+	/* the following ones replay it, alternating between two sets of arrays */
+	for (ii=1; ii<NB_STEPS; ++ii) {
+		ah5_data_wait(ah5_inst, data[ii%2]);
+		ah5_data_wait(ah5_inst, &steps[ii%2]);
+		data_init(data[ii%2], ii);
+		steps[ii%2] = ii;
+		arrays[0] = data[ii%2];
+		arrays[1] = &steps[ii%2];
+		sprintf(fname, "plan.%d.h5", ii);
+		if ( ah5_plan_run(ah5_inst, plan, fname, arrays) ) return 1;
+	}
+	ah5_plan_free(ah5_inst, plan);
+	ah5_finalize(ah5_inst);
+
+	for (ii=0; ii<NB_STEPS; ++ii) {
+		sprintf(fname, "plan.%d.h5", ii);
+		nb_errors += data_check(fname, ii);
+	}
+	free(data[0]);
+	free(data[1]);
+	return nb_errors != 0;
+}
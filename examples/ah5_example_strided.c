@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * Copyright (c) 2013-2014, Julien Bigot - CEA (julien.bigot@cea.fr)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * * Neither the name of the <organization> nor the
+ * names of its contributors may be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <ah5.h>
+
+#define DATA_HEIGHT 300
+#define DATA_WIDTH 240
+#define COL_STRIDE 3
+#define ACC(data, yy, xx) data[(xx)+(yy)*DATA_WIDTH]
+
+int main(void)
+{
+	ah5_t ah5_inst;
+	double *data, *read;
+	int yy, xx, nb_errors = 0;
+	hid_t file_id, dset_id, space_id;
+	/* the section data(DATA_HEIGHT:1:-1, 1:DATA_WIDTH:COL_STRIDE) of a
+	 * Fortran array, i.e. the rows in reverse order and every third column */
+	hsize_t dims[2] = { DATA_HEIGHT, DATA_WIDTH/COL_STRIDE };
+	int64_t strides[2] = { -DATA_WIDTH, COL_STRIDE };
+	/* only a part of the section is written */
+	hsize_t lbounds[2] = { 10, 5 };
+	hsize_t ubounds[2] = { DATA_HEIGHT-20, DATA_WIDTH/COL_STRIDE-3 };
+	hsize_t read_dims[2];
+
+
+	ah5_init(&ah5_inst);
+	data = malloc(DATA_WIDTH*DATA_HEIGHT*sizeof(double));
+	for (yy=0; yy<DATA_HEIGHT; ++yy) {
+		for (xx=0; xx<DATA_WIDTH; ++xx) {
+			ACC(data, yy, xx) = yy*1000. + xx;
+		}
+	}
+
+	ah5_start(ah5_inst, "strided.h5");
+	ah5_write_strided(ah5_inst, &ACC(data, DATA_HEIGHT-1, 0), "data", H5T_NATIVE_DOUBLE, 2,
+			dims, strides, lbounds, ubounds, NULL, NULL);
+	ah5_finish(ah5_inst);
+	ah5_finalize(ah5_inst);
+
+	file_id = H5Fopen("strided.h5", H5F_ACC_RDONLY, H5P_DEFAULT);
+	dset_id = H5Dopen2(file_id, "data", H5P_DEFAULT);
+	space_id = H5Dget_space(dset_id);
+	H5Sget_simple_extent_dims(space_id, read_dims, NULL);
+	H5Sclose(space_id);
+	if ( read_dims[0] != ubounds[0]-lbounds[0] || read_dims[1] != ubounds[1]-lbounds[1] ) {
+		fprintf(stderr, "strided.h5: unexpected dimensions\n");
+		return 1;
+	}
+	read = malloc(read_dims[0]*read_dims[1]*sizeof(double));
+	if ( H5Dread(dset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, read) < 0 ) ++nb_errors;
+	H5Dclose(dset_id);
+	H5Fclose(file_id);
+	for (yy=0; yy<(int)read_dims[0]; ++yy) {
+		for (xx=0; xx<(int)read_dims[1]; ++xx) {
+			int row = DATA_HEIGHT-1-(yy+(int)lbounds[0]);
+			int col = (xx+(int)lbounds[1])*COL_STRIDE;
+			if ( read[xx+yy*read_dims[1]] != ACC(data, row, col) ) ++nb_errors;
+		}
+	}
+
+	if ( nb_errors ) fprintf(stderr, "strided.h5: %d errors\n", nb_errors);
+	free(data);
+	free(read);
+	return nb_errors != 0;
+}
@@ -25,6 +25,8 @@
 #ifndef ASYNC_HDF5_H__
 #define ASYNC_HDF5_H__
 
+#include <stdint.h>
+
 #include <hdf5.h>
 
 typedef enum {
@@ -34,8 +36,106 @@ typedef enum {
 	VERBOSITY_DEBUG
 } ah5_verbosity_t;
 
+/** Flags controling the allocation of the staging buffers
+ */
+typedef enum {
+	AH5_STAGING_HUGEPAGES=1, /**< advise the use of transparent huge pages */
+	AH5_STAGING_HUGETLB=2, /**< map explicit huge pages, fallback to regular pages */
+	AH5_STAGING_PRETOUCH=4, /**< touch the pages as soon as they are mapped */
+	AH5_STAGING_MLOCK=8 /**< lock the pages in memory */
+} ah5_staging_t;
+
+/** Compression methods for chunked datasets
+ */
+typedef enum {
+	AH5_COMPRESS_NONE=0, /**< no compression */
+	AH5_COMPRESS_DEFLATE, /**< deflate (zlib), level from 0 to 9 */
+	AH5_COMPRESS_ZSTD /**< zstd (HDF5 filter 32015), level from 1 to 22 */
+} ah5_compression_t;
+
+/** Policies applied when staging a command list would exceed the memory
+ * limit
+ */
+typedef enum {
+	AH5_BACKPRESSURE_BLOCK=0, /**< wait for the writer to release enough memory */
+	AH5_BACKPRESSURE_SKIP, /**< drop the whole command list */
+	AH5_BACKPRESSURE_DEGRADE, /**< drop the non-essential copied variables, then wait */
+	AH5_BACKPRESSURE_SPILL /**< stage the command list in a scratch file */
+} ah5_backpressure_t;
+
+/** The phases whose duration is measured
+ */
+typedef enum {
+	AH5_PHASE_WAIT=0, /**< the user thread waiting for a slot or for memory to be released */
+	AH5_PHASE_COPY, /**< the copy of a Data in the staging buffer */
+	AH5_PHASE_CREATE, /**< the creation or opening of a file or a dataset */
+	AH5_PHASE_WRITE, /**< the writing of a block of a Data */
+	AH5_PHASE_CLOSE, /**< the closing of a dataset or a file */
+	AH5_PHASE_SCHED, /**< a writer thread waiting for the shared scheduler */
+	AH5_PHASE_READ, /**< the reading of a block of a loaded Data */
+	AH5_NB_PHASES
+} ah5_phase_t;
+
+/** The number of buckets of the latency histograms, bucket i counts the
+ * durations from 2^i to 2^(i+1) microseconds, bucket 0 those below 2 and the
+ * last one those above
+ */
+#define AH5_HIST_BUCKETS 32
+
+/** Formats of the statistics file
+ */
+typedef enum {
+	AH5_STATS_JSON=0, /**< a JSON object */
+	AH5_STATS_CSV /**< one metric,value line per metric */
+} ah5_stats_format_t;
+
+/** The durations measured for one phase
+ */
+typedef struct {
+	uint64_t count; /**< the number of measures */
+	uint64_t total_us; /**< the sum of the durations in microseconds */
+	uint64_t max_us; /**< the longest duration in microseconds */
+	uint64_t histogram[AH5_HIST_BUCKETS]; /**< the number of measures per bucket */
+} ah5_phase_stats_t;
+
+/** I/O statistics of an instance or of a single command list
+ */
+typedef struct {
+	uint64_t lists; /**< the number of command lists fully written */
+	uint64_t lists_skipped; /**< the number of command lists dropped to stay below the memory limit */
+	uint64_t lists_degraded; /**< the number of command lists written without their non-essential variables */
+	uint64_t lists_spilled; /**< the number of command lists staged in a scratch file */
+	uint64_t bytes_copied; /**< the number of bytes copied in the staging buffers */
+	uint64_t bytes_written; /**< the number of bytes written to the files */
+	uint64_t bytes_linked; /**< the number of bytes of unchanged variables replaced by links */
+	uint64_t blocked_us; /**< the time spent by the user in ah5_start, ah5_write and ah5_finish */
+	uint64_t io_us; /**< the time spent writing the command lists, from file creation to closing */
+	double copy_bandwidth; /**< bytes copied per second of copy */
+	double write_bandwidth; /**< bytes written per second of io_us */
+	double overlap; /**< the fraction of io_us the user was not blocked for */
+	ah5_phase_stats_t phases[AH5_NB_PHASES]; /**< the durations per ah5_phase_t */
+} ah5_stats_t;
+
 typedef struct ah5* ah5_t;
 
+/** A command list recorded once to be replayed with new data pointers
+ */
+typedef struct ah5_plan* ah5_plan_t;
+
+/** Identifies a variable or a command list whose user memory release can be
+ * tested or waited for
+ */
+typedef int64_t ah5_token_t;
+
+/** A function called once a command list is complete
+ * @param token the token of the command list
+ * @param file_name the file of the command list
+ * @param status 0 if the command list has been fully written, ECANCELED if
+ * it has been skipped by the backpressure policy
+ * @param arg the argument given to ah5_set_callback
+ */
+typedef void (*ah5_callback_t)( ah5_token_t token, const char* file_name, int status, void* arg );
+
 /** Initializes the asynchronous HDF5 writer instance
  * @param self a pointer to the instance state to be allocated
  * @returns 0 on success, non-null on error
@@ -43,6 +143,24 @@ typedef struct ah5* ah5_t;
  */
 int ah5_init( ah5_t* pself );
 
+#ifdef H5_HAVE_PARALLEL
+/** Initializes an asynchronous HDF5 writer instance whose files are written
+ * collectively by all processes of a communicator into a single shared file.
+ * All processes must then issue the same command lists, with the same
+ * variables in the same order.
+ * @param self a pointer to the instance state to be allocated
+ * @param comm the communicator of the processes writing together, MPI must
+ * have been initialized with MPI_THREAD_MULTIPLE
+ * @returns 0 on success, non-null on error
+ * @post the writer thread is ready
+ */
+int ah5_init_mpi( ah5_t* pself, MPI_Comm comm );
+
+/** Same as ah5_init_mpi but takes a Fortran communicator
+ */
+int ah5_init_mpi_f( ah5_t* pself, MPI_Fint comm );
+#endif
+
 /** Sets the minimum verbosity level to actually log
  * @param self a pointer to the instance state
  * @param log_lvl the minimum verbosity level to actually log
@@ -59,6 +177,16 @@ int ah5_set_loglvl( ah5_t self, ah5_verbosity_t log_lvl );
  */
 int ah5_set_logfile( ah5_t self, char* log_file );
 
+/** Sets a file where to dump the cumulative I/O statistics when the instance
+ * is finalized (none by default)
+ * @param self a pointer to the instance state
+ * @param stats_file the file where to dump the statistics, NULL for none
+ * @param format the ah5_stats_format_t format of the file
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_statsfile( ah5_t self, char* stats_file, int format );
+
 /** Sets whether to write scalars as a 1D size 1 array
  * @param self a pointer to the instance state
  * @param scalar_as_array whether to write scalars as a 1D size 1 array
@@ -67,14 +195,351 @@ int ah5_set_logfile( ah5_t self, char* log_file );
  */
 int ah5_set_scalarray( ah5_t self, int scalar_as_array );
 
-/** Sets whether to do copies in parallel using all cores
+/** Sets whether to do copies in parallel using the copy threads
  * @param self a pointer to the instance state
- * @param parallel_copy Whether to do copies in parallel using all cores
+ * @param parallel_copy Whether to do copies in parallel using the copy threads
  * @returns 0 on success, non-null on error
  * @invariant the writer thread is ready
  */
 int ah5_set_paracopy( ah5_t self, int parallel_copy );
 
+/** Sets the number of threads that share the copies with the thread that
+ * issues them, waits for all the previous writes to finish. By default, there
+ * is one thread per CPU the process is allowed to run on, minus one.
+ * @param self a pointer to the instance state
+ * @param nb_copiers the number of copy threads
+ * @param cpus the CPU each copy thread is bound to or NULL not to bind them
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_copiers( ah5_t self, int nb_copiers, int* cpus );
+
+/** Sets the CPUs the writer threads and the background copy thread are
+ * bound to, waits for all the previous writes to finish
+ * @param self a pointer to the instance state
+ * @param nb_cpus the number of CPUs, 0 not to bind the threads (the default)
+ * @param cpus the CPUs
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_writercpus( ah5_t self, int nb_cpus, int* cpus );
+
+/** Sets whether to copy the data in the staging buffer in background instead
+ * of in ah5_finish. Each user array can be modified again once its own copy is
+ * done, see ah5_get_vartoken and ah5_data_wait.
+ * @param self a pointer to the instance state
+ * @param deferred_copy whether to copy in background (false by default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_deferred( ah5_t self, int deferred_copy );
+
+/** Sets whether the following command lists append to a series instead of
+ * each creating its own file, waits for all the previous writes to finish.
+ * Successive command lists started with the same file name append to the
+ * same file where each variable is stored in an extendible dataset whose
+ * first dimension is the time. Starting a command list with another name
+ * closes the current series and starts a new one.
+ * @param self a pointer to the instance state
+ * @param append whether to append to a series (false by default)
+ * @param flush_steps the number of command lists between flushes of the
+ * series file to disk, 0 to only flush it when it is closed
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_append( ah5_t self, int append, int flush_steps );
+
+/** Sets when a series rolls over to a new file, the files following the
+ * first one are numbered before the extension of the file name (out.h5,
+ * out.1.h5, out.2.h5, ...)
+ * @param self a pointer to the instance state
+ * @param max_steps the number of command lists after which to roll over, 0
+ * for no limit (the default)
+ * @param max_bytes the number of bytes after which to roll over, 0 for no
+ * limit (the default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_rollover( ah5_t self, int max_steps, size_t max_bytes );
+
+/** Sets the number of writer threads, waits for all the previous writes to
+ * finish. Multiple writer threads write distinct command lists in parallel
+ * and share the writing of large datasets.
+ * @param self a pointer to the instance state
+ * @param nb_writers the number of writer threads (1 by default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_writers( ah5_t self, int nb_writers );
+
+/** Sets whether collective writes use two-phase aggregation (MPI-IO
+ * collective buffering) or let each process write its own part, waits for
+ * all the previous writes to finish
+ * @param self a pointer to the instance state
+ * @param two_phase whether to use two-phase aggregation (the default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_collective( ah5_t self, int two_phase );
+
+/** Sets whether the files are built in memory and written once closed with
+ * large writes that bypass the page cache (O_DIRECT) when the file system
+ * supports it, waits for all the previous writes to finish. Files appended
+ * to are written when their series is closed. Not available with collective
+ * writes.
+ * @param self a pointer to the instance state
+ * @param image whether to build the files in memory (0 by default)
+ * @param block_size the size of the writes in bytes, rounded up to 4 KiB, 0
+ * for the default of 16 MiB
+ * @param sync whether to synchronize each file once written
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_fileimage( ah5_t self, int image, size_t block_size, int sync );
+
+/** Sets whether the files are written with the io_uring file driver, waits
+ * for all the previous writes to finish. Small writes are copied and
+ * coalesced with the adjacent ones, larger ones are written from the data
+ * with up to queue_depth writes in flight. The default driver is used when
+ * io_uring is not available. Files built in memory take precedence. Not
+ * available with collective writes.
+ * @param self a pointer to the instance state
+ * @param queue_depth the maximum number of writes in flight, 0 for the
+ * default driver (the default)
+ * @param buffer_size the size of the coalescing buffers and of the pieces
+ * larger writes are split in, 0 for the default of 1 MiB
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_uring( ah5_t self, int queue_depth, size_t buffer_size );
+
+/** Sets whether the files are first written in a fast node-local directory
+ * (tmpfs, local NVMe...) and then moved to their final path by background
+ * drain threads, renamed when both are on the same file system and copied
+ * with large sequential I/O otherwise. Series files are always written in
+ * place. Waits for the files of the previous burst buffer to be drained. The
+ * command lists are complete for ah5_test, ah5_wait and the callback once
+ * their file is in the burst buffer, ah5_drain waits for their final path.
+ * @param self a pointer to the instance state
+ * @param local_dir the node-local directory, NULL to write the files in place
+ * (the default)
+ * @param capacity the size of the files waiting in local_dir above which the
+ * writer threads wait for the drain threads before creating new files, 0 for
+ * no limit
+ * @param nb_drainers the number of files drained concurrently
+ * @param ordered whether the files appear at their final path in the order
+ * they were created, otherwise each appears as soon as it is drained
+ * @returns 0 on success, non-null on error
+ * @pre no command list is being filled
+ * @invariant the writer thread is ready
+ */
+int ah5_set_burstbuffer( ah5_t self, char* local_dir, size_t capacity, int nb_drainers,
+		int ordered );
+
+/** Sets whether the following write commands read the data directly from the
+ * user arrays in the writer thread instead of copying it in a local buffer
+ * when the command list is finished. The user arrays must then not be
+ * modified until their token is released.
+ * @param self a pointer to the instance state
+ * @param nocopy whether to write the following variables without copy
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_nocopy( ah5_t self, int nocopy );
+
+/** Sets whether the following write commands are essential, the others may be
+ * dropped by the AH5_BACKPRESSURE_DEGRADE policy
+ * @param self a pointer to the instance state
+ * @param essential whether the following variables are essential (the
+ * default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_essential( ah5_t self, int essential );
+
+/** Sets whether the following write commands are only written when they
+ * changed. Their user array is fingerprinted in ah5_finish and, when it is
+ * the same as the last time a variable of that name was written, the variable
+ * is neither copied nor written but replaced by an HDF5 external link to the
+ * dataset of the file holding its last copy, which must be kept. Before a
+ * file linked into is overwritten, the linked datasets are copied into the
+ * files linking to them, and no file links into it afterwards. Series and
+ * collective files are always fully written.
+ * @param self a pointer to the instance state
+ * @param delta whether the following variables are only written when they
+ * changed (default: no)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_delta( ah5_t self, int delta );
+
+/** Sets the type the following write commands store in the file, the data is
+ * converted while it is copied in the local buffer so that the writer threads
+ * write less. Values are stored as (value-offset)/scale, rounded and clamped
+ * for integer types, and the scale_factor and add_offset attributes of the CF
+ * conventions are attached to the datasets packed this way. Double arrays can
+ * be stored as native float, short or int and float arrays as native short or
+ * int. Converted variables are always copied, whatever ah5_set_nocopy says.
+ * @param self a pointer to the instance state
+ * @param type the HDF5 type to store, negative to store each variable with
+ * its own type (the default)
+ * @param scale the scale of the stored values, non-null
+ * @param offset the offset of the stored values
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_filetype( ah5_t self, hid_t type, double scale, double offset );
+
+/** Sets the chunk dimensions of the datasets for the following write
+ * commands. Chunk dimensions are computed automatically when the rank of a
+ * variable does not match or when compression requires chunking.
+ * @param self a pointer to the instance state
+ * @param rank the number of dimensions of the chunks (0 for contiguous
+ * datasets, the default)
+ * @param chunk_dims the dimensions of the chunks
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_chunking( ah5_t self, int rank, hsize_t* chunk_dims );
+
+/** Sets the compression of the datasets for the following write commands.
+ * Chunks are filtered by the writer threads in parallel and handed to HDF5
+ * with direct chunk writes.
+ * @param self a pointer to the instance state
+ * @param method the compression method (AH5_COMPRESS_NONE by default)
+ * @param level the compression level
+ * @param shuffle whether to shuffle the bytes of the elements before
+ * compression
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_compression( ah5_t self, ah5_compression_t method, int level, int shuffle );
+
+/** Sets how the staging buffers are allocated and reserves them, waits for
+ * all the previous writes to finish. Staging buffers persist across command
+ * lists and grow geometrically when more memory is required. Fails with EBUSY
+ * while loaded data is not released.
+ * @param self a pointer to the instance state
+ * @param flags a combination of ah5_staging_t flags
+ * @param reserve the size in bytes to reserve right now in each slot
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_staging( ah5_t self, int flags, size_t reserve );
+
+/** Sets the maximum memory used by all staging buffers together, finishing a
+ * command list that would exceed it applies the backpressure policy
+ * @param self a pointer to the instance state
+ * @param mem_limit the maximum memory in bytes, 0 for no limit (the default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_memlimit( ah5_t self, size_t mem_limit );
+
+/** Sets what happens when finishing a command list would exceed the memory
+ * limit. Whatever the policy, the staging buffers of the free slots are
+ * released first. Blocking fails with ENOMEM if no command list is in flight
+ * to release memory.
+ * @param self a pointer to the instance state
+ * @param policy an ah5_backpressure_t policy, AH5_BACKPRESSURE_BLOCK by
+ * default
+ * @param spill_dir the directory of the scratch files of
+ * AH5_BACKPRESSURE_SPILL, NULL for the default temporary directory
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_backpressure( ah5_t self, int policy, char* spill_dir );
+
+/** Sets whether the instance shares a process-wide scheduler with the other
+ * instances that use it. The scheduler lets a limited number of writer
+ * threads of all its instances do I/O at the same time, serving the waiting
+ * instances by decreasing priority and, for equal priorities, the one that
+ * has written the fewest bytes first. It also bounds the staging memory of
+ * the command lists in flight in all its instances, see ah5_set_schedlimits.
+ * @param self a pointer to the instance state
+ * @param priority the priority of the instance, negative to stop using the
+ * scheduler (the default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_scheduler( ah5_t self, int priority );
+
+/** Sets the limits of the process-wide scheduler, they apply to all the
+ * instances that use it
+ * @param self a pointer to the instance state
+ * @param nb_writers the maximum number of writer threads doing I/O at the
+ * same time (1 by default)
+ * @param mem_limit the maximum staging memory of the command lists in flight,
+ * ah5_finish waits until it is available, 0 for no limit (the default)
+ * @returns 0 on success, non-null on error
+ */
+int ah5_set_schedlimits( ah5_t self, int nb_writers, size_t mem_limit );
+
+/** Sets the number of command lists that can be in flight at the same time,
+ * waits for all the previous writes to finish. Fails with EBUSY while a
+ * command list is filled or loaded data is not released.
+ * @param self a pointer to the instance state
+ * @param depth the number of command list slots (1 by default)
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_depth( ah5_t self, int depth );
+
+/** Sets a function to call once each command list is complete. It is called
+ * from a writer thread after the file is closed and before the slot is
+ * released, so it must neither wait for a command list nor finish one.
+ * @param self a pointer to the instance state
+ * @param callback the function to call, NULL for none (the default)
+ * @param arg the argument passed to the function
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_set_callback( ah5_t self, ah5_callback_t callback, void* arg );
+
+/** Gets the number of command list slots currently in use, either being
+ * built, waiting for the writer thread or being written, without waiting
+ * for the writer threads
+ * @param self a pointer to the instance state
+ * @param nb_used the number of slots in use
+ * @returns 0 on success, non-null on error
+ */
+int ah5_get_inflight( ah5_t self, int* nb_used );
+
+/** Tests whether all the finished command lists have been fully written,
+ * without waiting for the writer threads
+ * @param self a pointer to the instance state
+ * @param done whether all the finished command lists have been written
+ * @returns 0 on success, non-null on error
+ */
+int ah5_test( ah5_t self, int* done );
+
+/** Waits for all the finished command lists to be fully written, at most for
+ * a given time
+ * @param self a pointer to the instance state
+ * @param timeout the maximum time to wait in seconds, negative to wait as
+ * long as needed
+ * @param done whether all the finished command lists have been written, it
+ * can only be false once the timeout has expired
+ * @returns 0 on success, non-null on error
+ */
+int ah5_wait( ah5_t self, double timeout, int* done );
+
+/** Waits for all the finished command lists to be fully written and for
+ * their files to leave the burst buffer, ah5_finalize does it implicitly
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ */
+int ah5_drain( ah5_t self );
+
+/** Gets the I/O statistics, cumulated since the initialization and for the
+ * last fully written command list
+ * @param self a pointer to the instance state
+ * @param total the cumulative statistics, or NULL
+ * @param last the statistics of the last fully written command list, or NULL
+ * @returns 0 on success, non-null on error
+ */
+int ah5_get_stats( ah5_t self, ah5_stats_t* total, ah5_stats_t* last );
+
 /** Finalizes the asynchronous HDF5 writer instance
  * @param self a pointer to the instance state
  * @returns 0 on success, non-null on error
@@ -82,7 +547,9 @@ int ah5_set_paracopy( ah5_t self, int parallel_copy );
  */
 int ah5_finalize( ah5_t self );
 
-/** Starts a file writing command list, wait for the previous write to finish
+/** Starts a file writing command list, waits for a command list slot to be
+ * freed if they are all in use. A command list holds at most 2^24-1 commands,
+ * the following ones fail with EINVAL.
  * @param self a pointer to the instance state
  * @param file_name the name of the file where to write the data
  * @returns 0 on success, non-null on error
@@ -91,7 +558,9 @@ int ah5_finalize( ah5_t self );
  */
 int ah5_start( ah5_t self, char* file_name );
 
-/** Issues a HDF5 write command, copy it in the command list
+/** Issues a HDF5 write command, copy it in the command list. Unless the list
+ * appends to a series or is written collectively, a writer thread may create
+ * the file and the dataset right away, and write the data if it is not copied.
  * @param self a pointer to the instance state
  * @param data a pointer to the data
  * @param name the name of the HDF5 field
@@ -107,6 +576,52 @@ int ah5_start( ah5_t self, char* file_name );
 int ah5_write( ah5_t self, void* data, char* name, hid_t type, int rank,
 				hsize_t* dims, hsize_t* lbounds, hsize_t* ubounds );
 
+/** Issues a HDF5 write command for a part of a larger dataset, copy it in the
+ * command list. In collective mode, each process writes its own part of the
+ * shared dataset.
+ * @param self a pointer to the instance state
+ * @param data a pointer to the data
+ * @param name the name of the HDF5 field
+ * @param type the HDF5 type of the data
+ * @param rank the number of dimensions of the data array (0 for scalar)
+ * @param dims the dimensions of the array containing the data
+ * @param lbounds the index of the first element to write in each dimension
+ * @param ubounds the index of the first element to not write in each dimension
+ * @param global_dims the dimensions of the whole dataset
+ * @param offset the position of the written part in the whole dataset
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is blocked
+ * @post the writer thread is blocked
+ */
+int ah5_write_global( ah5_t self, void* data, char* name, hid_t type, int rank,
+				hsize_t* dims, hsize_t* lbounds, hsize_t* ubounds, hsize_t* global_dims,
+				hsize_t* offset );
+
+/** Issues a HDF5 write command for a strided array, e.g. a Fortran pointer
+ * section, the selected elements are gathered directly in the command list
+ * without the need for a contiguous temporary.
+ * @param self a pointer to the instance state
+ * @param data a pointer to the element of index 0 in all dimensions
+ * @param name the name of the HDF5 field
+ * @param type the HDF5 type of the data
+ * @param rank the number of dimensions of the data array (0 for scalar)
+ * @param dims the dimensions of the array containing the data
+ * @param strides the distance in elements between consecutive elements in
+ * each dimension, possibly negative, NULL for a contiguous array
+ * @param lbounds the index of the first element to write in each dimension
+ * @param ubounds the index of the first element to not write in each dimension
+ * @param global_dims the dimensions of the whole dataset, NULL if the written
+ * part is the whole dataset
+ * @param offset the position of the written part in the whole dataset, NULL
+ * for the origin
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is blocked
+ * @post the writer thread is blocked
+ */
+int ah5_write_strided( ah5_t self, void* data, char* name, hid_t type, int rank,
+				hsize_t* dims, int64_t* strides, hsize_t* lbounds, hsize_t* ubounds,
+				hsize_t* global_dims, hsize_t* offset );
+
 /** Finishes a file writing command list, copies the data to a local buffer and
  * launches the writer thread
  * @param self a pointer to the instance state
@@ -116,4 +631,146 @@ int ah5_write( ah5_t self, void* data, char* name, hid_t type, int rank,
  */
 int ah5_finish( ah5_t self );
 
+/** Gets the token of the last write command issued in the current command
+ * list, released once its user array can be modified again
+ * @param self a pointer to the instance state
+ * @param token the token of the variable
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is blocked
+ */
+int ah5_get_vartoken( ah5_t self, ah5_token_t* token );
+
+/** Gets the token of the current command list, released once all its user
+ * arrays can be modified again, i.e. once it has been fully written
+ * @param self a pointer to the instance state
+ * @param token the token of the command list
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is blocked
+ */
+int ah5_get_listtoken( ah5_t self, ah5_token_t* token );
+
+/** Tests whether the memory associated to a token has been released
+ * @param self a pointer to the instance state
+ * @param token the token to test
+ * @param released whether the memory has been released
+ * @returns 0 on success, non-null on error
+ */
+int ah5_token_test( ah5_t self, ah5_token_t token, int* released );
+
+/** Waits for the memory associated to a token to be released
+ * @param self a pointer to the instance state
+ * @param token the token to wait for
+ * @returns 0 on success, non-null on error
+ */
+int ah5_token_wait( ah5_t self, ah5_token_t token );
+
+/** Tests whether a user array is still needed by a sealed command list, i.e.
+ * whether it can be modified
+ * @param self a pointer to the instance state
+ * @param data the user array passed to ah5_write
+ * @param released whether the array can be modified
+ * @returns 0 on success, non-null on error
+ */
+int ah5_data_test( ah5_t self, void* data, int* released );
+
+/** Waits for a user array not to be needed by any sealed command list anymore
+ * @param self a pointer to the instance state
+ * @param data the user array passed to ah5_write
+ * @returns 0 on success, non-null on error
+ */
+int ah5_data_wait( ah5_t self, void* data );
+
+/** Records the current command list in a plan that can be replayed with new
+ * data pointers, with the dataspaces, property lists and staging layout
+ * computed once. The current command list is not modified and must still be
+ * finished.
+ * @param self a pointer to the instance state
+ * @param plan the plan to be allocated
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is blocked
+ */
+int ah5_plan_save( ah5_t self, ah5_plan_t* plan );
+
+/** Replays a plan, i.e. starts a command list, issues the write commands of
+ * the plan with new data pointers and finishes it
+ * @param self a pointer to the instance state
+ * @param plan the plan to replay
+ * @param file_name the name of the file where to write
+ * @param data the arrays to write, in the order of the write commands of the
+ * plan
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is ready
+ * @post the writer thread is ready
+ */
+int ah5_plan_run( ah5_t self, ah5_plan_t plan, char* file_name, void** data );
+
+/** Frees a plan, waits for all the previous writes to finish
+ * @param self a pointer to the instance state
+ * @param plan the plan to free
+ * @returns 0 on success, non-null on error
+ * @invariant the writer thread is ready
+ */
+int ah5_plan_free( ah5_t self, ah5_plan_t plan );
+
+/** Starts a file loading command list, its Data are read by the writer
+ * threads once it is finished, in the order they were issued, while the user
+ * thread goes on. Waits for a command list slot to be freed if they are all
+ * in use. Like a writing one, it holds at most 2^24-1 commands.
+ * @param self a pointer to the instance state
+ * @param file_name the name of the file where to read the data
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is ready
+ * @post the writer thread is blocked
+ */
+int ah5_load_start( ah5_t self, char* file_name );
+
+/** Issues a HDF5 read command in a loading command list. The token returned
+ * by ah5_get_vartoken is released, and ah5_data_wait returns, once the Data
+ * has been loaded.
+ * @param self a pointer to the instance state
+ * @param data the array where to load the data, NULL to load it in the
+ * staging buffer, see ah5_load_data
+ * @param name the name of the HDF5 dataset
+ * @param type the HDF5 type of the data in memory, converted by HDF5 from the
+ * type of the dataset
+ * @param rank the number of dimensions of the data array (0 for scalar)
+ * @param dims the dimensions of the array where to load the data
+ * @param lbounds the index of the first element to load in each dimension
+ * @param ubounds the index of the first element to not load in each dimension
+ * @param offset the position of the loaded part in the dataset, NULL for the
+ * origin
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is blocked
+ * @post the writer thread is blocked
+ */
+int ah5_load( ah5_t self, void* data, char* name, hid_t type, int rank, hsize_t* dims,
+				hsize_t* lbounds, hsize_t* ubounds, hsize_t* offset );
+
+/** Finishes a file loading command list and launches the writer thread
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is blocked
+ * @post the writer thread is ready
+ */
+int ah5_load_finish( ah5_t self );
+
+/** Waits for a Data of a loading command list to be loaded and gets where it
+ * has been loaded, in the staging buffer if it was issued without an array
+ * @param self a pointer to the instance state
+ * @param token the token of the Data, see ah5_get_vartoken
+ * @param data where the Data has been loaded, its part between lbounds and
+ * ubounds only if it has been loaded in the staging buffer
+ * @returns 0 on success, non-null on error
+ */
+int ah5_load_data( ah5_t self, ah5_token_t token, void** data );
+
+/** Releases the staging buffer of a loading command list. A list with Data
+ * loaded in its staging buffer keeps its slot until it is released, the other
+ * ones release it once they are fully loaded.
+ * @param self a pointer to the instance state
+ * @param token the token of the command list or of one of its Data
+ * @returns 0 on success, non-null on error
+ */
+int ah5_load_release( ah5_t self, ah5_token_t token );
+
 #endif /* ASYNC_HDF5_H__ */
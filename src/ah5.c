@@ -27,34 +27,209 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <math.h>
-#ifdef _OPENMP
-#include <omp.h>
-#endif
 #include <pthread.h>
+#include <sched.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef AH5_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef AH5_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef AH5_HAVE_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
 
 #include "ah5.h"
 
 
-/** Maximum number of thread supported in the multiple thread copy
- *
- * \todo automatically detect the actual max number of thread or dynamically
- * detect it so as not to crash on MIC for example
+/** Maximum number of dimensions supported for arrays
  */
-#define MAX_NB_THREAD 32
+#define MAX_RANK 7
 
 
-/** Maximum number of dimensions supported for arrays
+/** Size of the huge pages used for the staging buffers with MAP_HUGETLB
  */
-#define MAX_RANK 7
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+
+/** Minimum size in bytes of the blocks a dataset is split in to be written by
+ * multiple writer threads
+ */
+#define WRITE_BLOCK_SIZE (16*1024*1024)
+
+
+/** Minimum size in bytes of a copy for it to bypass the caches with
+ * non-temporal stores, smaller copies are better left in cache
+ */
+#define NT_COPY_SIZE (4*1024*1024)
+
+
+/** Minimum size in bytes of the contiguous runs copied with non-temporal
+ * stores, shorter runs only partially fill the write-combining buffers
+ */
+#define NT_RUN_SIZE 256
+
+
+/** Number of rows ahead to prefetch when copying runs much shorter than a
+ * cache line
+ */
+#define PREFETCH_ROWS 8
+
+
+/** Target size in bytes of the chunks when their dimensions are not specified
+ */
+#define CHUNK_SIZE (1024*1024)
+
+
+/** Identifier of the zstd filter registered with the HDF group
+ */
+#define H5Z_FILTER_ZSTD 32015
+
+
+#if H5_VERSION_GE(1, 10, 3)
+/** Whether chunks can be written directly, bypassing the HDF5 filter pipeline
+ */
+#define DIRECT_CHUNK_WRITE 1
+#endif
+
+
+/** Number of low bits of a token used to identify a variable in its command
+ * list, the high bits hold the serial number of the command list
+ */
+#define TOKEN_VAR_BITS 24
+
+
+/** The maximum number of commands in a command list, their index must fit in
+ * the low bits of their token
+ */
+#define MAX_COMMANDS ((UINT64_C(1)<<TOKEN_VAR_BITS)-1)
+
+
+/** The minimum size of the blocks where the names of the Data are stored
+ */
+#define NAME_BLOCK_SIZE 4096
+
+
+/** The alignment of the memory, offsets and sizes of the direct writes of the
+ * in-memory file images
+ */
+#define IMAGE_ALIGNMENT 4096
+
+
+/** The default size of the writes of the in-memory file images
+ */
+#define IMAGE_BLOCK_SIZE (16*1024*1024)
+
+
+/** The size of the reads and writes copying a file out of the burst buffer
+ */
+#define DRAIN_BLOCK_SIZE (16*1024*1024)
+
+
+/** The suffix of the files being drained next to their final path
+ */
+#define DRAIN_SUFFIX ".ah5drain"
+
+
+/** The number of buckets of the table of the fingerprints of the variables
+ * written in delta mode
+ */
+#define DELTA_BUCKETS 256
+
+
+/** The number of memory types whose size and conversion are remembered
+ */
+#define TYPE_CACHE_SIZE 16
+
+
+/** A kernel converting elements from the type of the user array to the type
+ * written in the file, as stored = (value-offset)/scale
+ * @param dest where to store the converted elements
+ * @param src the elements to convert
+ * @param nb the number of elements
+ * @param scale the scale of the stored values
+ * @param offset the offset of the stored values
+ */
+typedef void (*convert_kernel_t)( void* dest, const void* src, size_t nb, double scale,
+		double offset );
+
+
+/** The conversion of a Data to the type written in the file
+ */
+typedef struct convert {
+
+	/** The kernel converting the elements, NULL if the Data is not converted
+	 */
+	convert_kernel_t kernel;
+
+	/** Size in bytes of an element in the user array
+	 */
+	size_t src_size;
+
+	/** Size in bytes of an element in the file
+	 */
+	size_t dest_size;
+
+	/** The scale of the stored values
+	 */
+	double scale;
+
+	/** The offset of the stored values
+	 */
+	double offset;
+
+} convert_t;
+
+
+/** What issuing a command needs to know about the type of a user array,
+ * looked up in HDF5 once so that the user thread does not wait for the HDF5
+ * lock held by the writer threads
+ */
+typedef struct type_info {
+
+	/** The HDF5 type of the user array, -1 for an unused entry
+	 */
+	hid_t type;
+
+	/** The type written in the file it was looked up for, -1 if none
+	 */
+	hid_t file_type;
+
+	/** Size in bytes of an element of the type
+	 */
+	size_t size;
+
+	/** Whether the type is the one written in the file
+	 */
+	int same;
+
+	/** The kernel converting the elements to the file type, NULL if none
+	 */
+	convert_kernel_t kernel;
+
+	/** Size in bytes of an element of the file type, 0 if none
+	 */
+	size_t file_size;
+
+} type_info_t;
 
 
 /** Represents an HDF5-write call to make
@@ -73,6 +248,11 @@ typedef struct data_id {
 	 */
 	hsize_t dims[MAX_RANK];
 
+	/** Distance in bytes between the elements of the array in each
+	 * dimension, possibly negative
+	 */
+	ptrdiff_t strides[MAX_RANK];
+
 	/** Lower bound of the part to write
 	 */
 	hsize_t lbounds[MAX_RANK];
@@ -81,422 +261,6179 @@ typedef struct data_id {
 	 */
 	hsize_t ubounds[MAX_RANK];
 
+	/** Dimensions of the whole dataset
+	 */
+	hsize_t global_dims[MAX_RANK];
+
+	/** Position of the written part in the whole dataset
+	 */
+	hsize_t offset[MAX_RANK];
+
 	/** Name of the Data
 	 */
 	char* name;
 
-	/** HDF5 type of the Data
+	/** HDF5 type of the Data, as written in the file
 	 */
 	hid_t type;
 
+	/** Size in bytes of an element of the Data, as written in the file
+	 */
+	size_t type_size;
+
+	/** The conversion of the Data while it is copied in the staging buffer
+	 */
+	convert_t convert;
+
+	/** Whether the Data is written in a chunked dataset
+	 */
+	int chunked;
+
+	/** Dimensions of the chunks (all null to compute them automatically)
+	 */
+	hsize_t chunk_dims[MAX_RANK];
+
+	/** The ah5_compression_t compression method of the dataset
+	 */
+	int compression;
+
+	/** The compression level
+	 */
+	int compression_level;
+
+	/** Whether to shuffle the bytes of the elements before compression
+	 */
+	int shuffle;
+
+	/** Whether the data is written directly from the user array instead of
+	 * being copied in the staging buffer
+	 */
+	int nocopy;
+
+	/** Where the data is copied in the staging buffer (NULL if nocopy)
+	 */
+	void* staging;
+
+	/** Whether the data to write is available, i.e. nocopy or copied
+	 */
+	int staged;
+
+	/** The number of rows (along the first dimension of the written part)
+	 * already copied in the staging buffer
+	 */
+	hsize_t staged_rows;
+
+	/** The dataspace of the dataset, cached by a plan (-1 if none)
+	 */
+	hid_t space_id;
+
+	/** The creation property list of the dataset, cached by a plan (-1 if
+	 * none)
+	 */
+	hid_t plist_id;
+
+	/** Whether the user array can be modified again
+	 */
+	int released;
+
+	/** Whether the Data has been written before its command list was sealed
+	 */
+	int written;
+
+	/** Whether the Data can not be dropped when the memory is short
+	 */
+	int essential;
+
+	/** Whether the Data has been dropped to stay below the memory limit
+	 */
+	int dropped;
+
+	/** Whether the Data is only written when it changed since it was last
+	 * written
+	 */
+	int delta;
+
+	/** Whether the Data is unchanged and replaced by a link to the file
+	 * holding its last copy
+	 */
+	int linked;
+
+	/** The fingerprint of the written part of the user array
+	 */
+	uint64_t hash;
+
+	/** The file holding the last copy of a linked Data, relative to the
+	 * directory of the file of its command list if they share it
+	 */
+	char* link_target;
+
+	/** The HDF5 dataset where the Data is written
+	 */
+	hid_t dset_id;
+
+	/** The number of blocks of the Data that remain to be written
+	 */
+	size_t pending_blocks;
+
 } data_id_t;
 
 
+/** A part of a Data, along its first dimension, to be written by one of the
+ * writer threads
+ */
+typedef struct write_block {
+
+	/** The index of the Data in its command list
+	 */
+	size_t did;
+
+	/** The first index of the block in the first dimension of the written part
+	 */
+	hsize_t start;
+
+	/** The size of the block in the first dimension
+	 */
+	hsize_t count;
+
+} write_block_t;
+
+
 /** The various commands that can be issued to the writer thread
  */
 typedef enum thread_command {
-	CMD_WAIT, /**< nothing to do, just wait */
-	CMD_WRITE, /**< start executing the command list */
-	CMD_TERMINATE /**< stop execution */
+	CMD_RUN, /**< execute the command lists as they are sealed */
+	CMD_TERMINATE /**< stop execution once all sealed command lists are written */
 } thread_command_t;
 
 
-/** Status of the asynchronous HDF5 instance
+/** The states a command list slot can be in
  */
-struct ah5 {
+typedef enum list_state {
+	LIST_FREE, /**< the slot is available for a new command list */
+	LIST_FILLING, /**< the command list is being built by the user */
+	LIST_READY, /**< the command list is sealed and waits for the writer thread */
+	LIST_WRITING, /**< the command list is being written by the writer thread */
+	LIST_LOADED /**< the command list is loaded, its staging buffer is in use */
+} list_state_t;
 
-	/** a mutex controling access to this instance */
-	pthread_mutex_t mutex;
 
-	/** a condition variable used to signal that the command has changed */
-	pthread_cond_t cond;
+/** A persistent memory area where the data is staged before being written
+ */
+typedef struct staging_arena {
 
-	/** the command to execute */
-	thread_command_t thread_cmd;
+	/** the mapped memory */
+	void* base;
 
-	/** the thread executing the command list */
-	pthread_t thread;
+	/** the size of the mapped memory */
+	size_t capacity;
 
-	/** the name of the file to write */
+	/** whether the memory is mapped from a scratch file, it then does not
+	 * count in the memory limit */
+	int spilled;
+
+} staging_arena_t;
+
+
+/** A file that successive command lists append their Data to, each Data
+ * becomes a dataset with an additional first (time) dimension
+ */
+typedef struct series {
+
+	/** a mutex serializing the opening of the file and its datasets */
+	pthread_mutex_t mutex;
+
+	/** the file name passed to ah5_start */
 	char* file_name;
 
-	/** The buffer where the data is copied */
-	void* data_buffer;
+	/** the number of files written before this one with the same name */
+	int index;
 
-	/** The actual command list */
-	data_id_t* data;
+	/** the HDF5 file, -1 until it is created */
+	hid_t file_id;
 
-	/** The number of commands in the list */
-	size_t data_size;
+	/** the number of command lists appended to the file */
+	uint64_t steps;
 
-	/** the file where to log */
-	FILE* log_file;
+	/** the number of bytes appended to the file */
+	size_t bytes;
 
-	/** the verbosity level */
-	int log_verbosity;
+	/** the number of command lists appending to the file that are not
+	 * fully written yet */
+	size_t nb_lists;
 
-	/** whether to write scalars as a 1D size 1 array */
-	int scalar_as_array;
+	/** whether command lists do not append to this file anymore */
+	int retired;
 
-	/** whether to use all core for copies */
-	int parallel_copy;
+} series_t;
 
-};
 
+/** A block of memory where the names of the Data of a command list are
+ * stored one after the other
+ */
+typedef struct name_block {
 
-#define LOG_ERROR( ... ) do {\
-	if (self->log_verbosity >= VERBOSITY_ERROR) {\
-		FILE* out = self->log_file? self->log_file : stderr;\
-		fprintf(out, "*** Error: %s:%d: ", __FILE__, __LINE__);\
-		fprintf(out , ##__VA_ARGS__);\
-		fprintf(out, "\n");\
-		fflush(out);\
-	}\
-} while (0)
+	/** the next block, NULL if none */
+	struct name_block* next;
 
+	/** the size of the names array */
+	size_t capacity;
 
+	/** the number of bytes of the names array in use */
+	size_t used;
 
-#define LOG_WARNING( ... ) do {\
-	if (self->log_verbosity >= VERBOSITY_WARNING) {\
-		FILE* out = self->log_file? self->log_file : stderr;\
-		fprintf(out, "*** Warning: %s:%d: ", __FILE__, __LINE__);\
-		fprintf(out , ##__VA_ARGS__);\
-		fprintf(out, "\n");\
-		fflush(out);\
-	}\
-} while (0)
+	/** the names */
+	char names[];
 
+} name_block_t;
 
-#define LOG_STATUS( ... ) do {\
-	if (self->log_verbosity >= VERBOSITY_STATUS) {\
-		FILE* out = self->log_file? self->log_file : stderr;\
-		fprintf(out, "*** Status: %s:%d: ", __FILE__, __LINE__);\
-		fprintf(out , ##__VA_ARGS__);\
-		fprintf(out, "\n");\
-		fflush(out);\
-	}\
-} while (0)
 
+/** A command list recorded once and replayed with new data pointers
+ */
+struct ah5_plan {
 
-#ifndef NDEBUG
-#define LOG_DEBUG( ... ) do {\
-	if (self->log_verbosity >= VERBOSITY_DEBUG) {\
-		FILE* out = self->log_file? self->log_file : stderr;\
-		fprintf(out, "*** Log: %s:%d: ", __FILE__, __LINE__);\
-		fprintf(out , ##__VA_ARGS__);\
-		fprintf(out, "\n");\
-		fflush(out);\
-	}\
-} while (0)
-#else
-#define LOG_DEBUG( ... )
-#endif
+	/** The Data of the list, with their dataspaces and property lists */
+	data_id_t* data;
 
+	/** The number of Data */
+	size_t data_size;
 
-#define SIGNAL_ERROR do {\
-	int errno_save = errno;\
-	LOG_ERROR(" ----- Fatal: exiting -----\n");\
-	errno = errno_save;\
-	perror(NULL);\
-	exit(errno_save);\
-} while (0)
+	/** The displacement of each Data in the staging buffer */
+	size_t* offsets;
 
+	/** The size of the staging buffer */
+	size_t buf_size;
 
-#define RETURN_ERROR do {\
-	int errno_save = errno;\
-	LOG_WARNING(" ----- Leaving function -----\n");\
-	errno = errno_save;\
-	perror(NULL);\
-	errno = errno_save;\
-	return errno_save;\
-} while (0)
+};
 
 
-/** Returns the number of microseconds elapsed since EPOCH
- * @returns the number of microseconds elapsed since EPOCH
+/** A file written in the burst buffer that waits to be drained to its final
+ * path
  */
-inline static int64_t clockget()
-{
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	return (int64_t)tv.tv_sec*1000*1000 + tv.tv_usec;
-}
+typedef struct drain {
 
-#if H5_VERS_MINOR > 8 || H5_VERS_MINOR == 8 && H5_VERS_RELEASE >= 14
-#define CLS_DSET_CREATE H5P_CLS_DATASET_CREATE_ID_g
-#else
-#define CLS_DSET_CREATE H5P_CLS_DATASET_CREATE_g
-#endif
+	/** the path of the file in the burst buffer */
+	char* local_name;
 
-/** The function executed by the writer thread
- * @param self_void a pointer to the instance state as a void*
- * @returns NULL
- */
-static void* writer_thread_loop( void* self_void )
-{
-	ah5_t self = self_void;
-	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	/** the final path of the file */
+	char* file_name;
+
+	/** the size of the file */
+	size_t size;
+
+	/** the rank of the file in the order the files were created */
+	uint64_t ticket;
+
+	/** whether the file is removed instead of drained */
+	int cancel;
+
+	/** the next file to drain */
+	struct drain* next;
+
+} drain_t;
+
+
+/** The fingerprint of the last copy of a variable written in delta mode
+ */
+typedef struct delta {
+
+	/** the name of the variable */
+	char* name;
+
+	/** the fingerprint of the written part of the user array */
+	uint64_t hash;
+
+	/** the HDF5 type of the dataset */
+	hid_t type;
+
+	/** the scale and offset of the values of a converted variable */
+	double scale, offset;
+
+	/** the number of dimensions */
+	unsigned rank;
+
+	/** the dimensions of the written part */
+	hsize_t count[MAX_RANK];
+
+	/** the dimensions of the whole dataset */
+	hsize_t global_dims[MAX_RANK];
+
+	/** the position of the written part in the whole dataset */
+	hsize_t position[MAX_RANK];
+
+	/** the file holding the last copy */
+	char* file_name;
+
+	/** the next variable in the same bucket */
+	struct delta* next;
+
+} delta_t;
+
+
+/** An external link written in delta mode
+ */
+typedef struct delta_link {
+
+	/** the file holding the link */
+	char* file_name;
+
+	/** the name of the linked variable, NULL for a file no longer linked into */
+	char* name;
+
+	/** the file holding the linked copy */
+	char* target;
+
+	/** the next link */
+	struct delta_link* next;
+
+} delta_link_t;
+
+
+/** A command list together with the buffer where its data is staged
+ */
+typedef struct cmd_list {
+
+	/** the state of this slot */
+	list_state_t state;
+
+	/** the serial number of the command list held by this slot */
+	uint64_t serial;
+
+	/** the name of the file to write */
+	char* file_name;
+
+	/** the path of the file in the burst buffer, NULL if it is written at
+	 * file_name */
+	char* local_name;
+
+	/** the rank of the file in the order of the burst buffer */
+	uint64_t ticket;
+
+	/** whether the list reads its Data from the file instead of writing them */
+	int load;
+
+	/** The buffer where the data is copied */
+	staging_arena_t data_buffer;
+
+	/** The actual command list */
+	data_id_t* data;
+
+	/** The number of commands in the list */
+	size_t data_size;
+
+	/** The number of commands the data array can hold */
+	size_t data_capacity;
+
+	/** The number of commands handed over to the writer threads, written by
+	 * the user thread only, the writer threads may read the commands below
+	 * it before the list is sealed */
+	size_t submitted;
+
+	/** A spin lock held by a writer thread accessing the commands before the
+	 * list is sealed and by the user thread to move the data array */
+	int data_lock;
+
+	/** The number of commands whose dataset has been created */
+	size_t created;
+
+	/** Whether the file has been created before the list was sealed */
+	int early;
+
+	/** Whether a writer thread is creating datasets before the list is
+	 * sealed */
+	int early_busy;
+
+	/** Whether the datasets can not be created before the list is sealed
+	 * anymore, the next one may be replaced by a link */
+	int early_stopped;
+
+	/** The blocks where the names of the Data are stored */
+	name_block_t* names;
+
+	/** The block where the next name is stored */
+	name_block_t* name_block;
+
+	/** The plan replayed by the list, that owns the names of its Data, NULL
+	 * if none */
+	ah5_plan_t plan;
+
+	/** The next command whose data is to be copied in background */
+	size_t next_copy;
+
+	/** The HDF5 file where the list is written */
+	hid_t file_id;
+
+	/** Whether to append the list to a series instead of creating a file */
+	int append;
+
+	/** The series the list is appended to, NULL if the list has its own file */
+	series_t* series;
+
+	/** The index of the list in the time dimension of the series datasets */
+	hsize_t step;
+
+	/** Whether to flush the series file once the list is written */
+	int flush;
+
+	/** The blocks the writer threads share to write the list */
+	write_block_t* blocks;
+
+	/** The number of blocks */
+	size_t nb_blocks;
+
+	/** The next block to be written */
+	size_t next_block;
+
+	/** The number of blocks that remain to be written */
+	size_t pending_blocks;
+
+	/** The staging memory the list accounts for in the shared scheduler */
+	size_t sched_bytes;
+
+	/** The time at which the writing started */
+	int64_t start_time;
+
+	/** The I/O statistics of the list */
+	ah5_stats_t stats;
+
+} cmd_list_t;
+
+
+/** A copy job, split in as many parts as there are threads in the pool
+ * @param arg the description of the job
+ * @param part the part to execute
+ * @param nb_parts the number of parts
+ */
+typedef void (*copy_job_t)( void* arg, size_t part, size_t nb_parts );
+
+
+/** A persistent pool of threads sharing the copies of the threads that use it
+ */
+typedef struct copy_pool {
+
+	/** the instance the pool belongs to */
+	struct ah5* self;
+
+	/** a mutex controling access to the pool */
+	pthread_mutex_t mutex;
+
+	/** a condition variable used to signal the threads that a job has been
+	 * posted or that they must terminate */
+	pthread_cond_t cond;
+
+	/** a condition variable used to signal that a job is complete */
+	pthread_cond_t done_cond;
+
+	/** the threads of the pool */
+	pthread_t* threads;
+
+	/** the number of threads in the pool, the thread posting a job works too */
+	int nb_threads;
+
+	/** the CPU each thread is bound to, or NULL for no binding */
+	int* cpus;
+
+	/** the job being executed, NULL if none */
+	copy_job_t job;
+
+	/** the description of the job being executed */
+	void* job_arg;
+
+	/** the number of the job being executed, each thread executes its part
+	 * once per job */
+	uint64_t generation;
+
+	/** the number of parts of the job not executed yet */
+	size_t pending_parts;
+
+	/** whether the threads must terminate */
+	int terminate;
+
+} copy_pool_t;
+
+
+/** Status of the asynchronous HDF5 instance
+ */
+struct ah5 {
+
+	/** a mutex controling access to this instance */
+	pthread_mutex_t mutex;
+
+	/** a condition variable used to signal the writer thread that a command
+	 * list has been sealed or that the command has changed */
+	pthread_cond_t cond;
+
+	/** a condition variable used to signal that a slot has been freed or that
+	 * the memory associated to a token has been released */
+	pthread_cond_t free_cond;
+
+	/** a condition variable used to signal the copy thread that a command list
+	 * has data to copy or that the command has changed */
+	pthread_cond_t copy_cond;
+
+	/** the thread copying the data of command lists in background */
+	pthread_t copy_thread;
+
+	/** the command to execute */
+	thread_command_t thread_cmd;
+
+	/** the threads executing the command lists */
+	pthread_t* threads;
+
+	/** the number of writer threads */
+	int nb_writers;
+
+	/** whether the writer threads and the copy thread are bound to
+	 * writer_cpus */
+	int bind_writers;
+
+	/** the CPUs the writer threads and the copy thread are bound to */
+	cpu_set_t writer_cpus;
+
+	/** the threads sharing the copies */
+	copy_pool_t pool;
+
+	/** The ring of command list slots */
+	cmd_list_t* lists;
+
+	/** The number of slots in the ring */
+	size_t nb_lists;
+
+	/** The slot where the next command list will be built */
+	size_t fill_idx;
+
+	/** The slot the writer thread will execute next */
+	size_t write_idx;
+
+	/** The serial number of the next command list to be started */
+	uint64_t next_serial;
+
+	/** the file where to log */
+	FILE* log_file;
+
+	/** the verbosity level */
+	int log_verbosity;
+
+	/** whether to write scalars as a 1D size 1 array */
+	int scalar_as_array;
+
+	/** whether to use the copy thread pool for copies */
+	int parallel_copy;
+
+	/** whether to copy the data in background instead of in ah5_finish */
+	int deferred_copy;
+
+	/** whether the next command lists append to a series */
+	int append;
+
+	/** the number of appended command lists between flushes (0 for none) */
+	int flush_steps;
+
+	/** the number of command lists after which a series rolls over to a new
+	 * file (0 for none) */
+	int rollover_steps;
+
+	/** the number of bytes after which a series rolls over to a new file (0
+	 * for none) */
+	size_t rollover_bytes;
+
+	/** the series command lists currently append to, NULL if none */
+	series_t* series;
+
+	/** whether the files are written collectively by all processes of an MPI
+	 * communicator */
+	int collective;
+
+	/** whether collective writes use two-phase aggregation */
+	int two_phase;
+
+	/** the file access property list used to create files */
+	hid_t file_plist;
+
+	/** the size of the writes of the files built in memory, 0 if the files
+	 * are written by HDF5 directly */
+	size_t image_block;
+
+	/** whether to synchronize the files built in memory once written */
+	int image_sync;
+
+	/** the maximum number of writes in flight of the io_uring file driver, 0
+	 * if the files are written with the default driver */
+	unsigned uring_depth;
+
+	/** the size of the buffers of the io_uring file driver */
+	size_t uring_buffer_size;
+
+	/** the data transfer property list used to write data */
+	hid_t xfer_plist;
+
+#ifdef H5_HAVE_PARALLEL
+	/** the communicator of the processes that write the files collectively */
+	MPI_Comm comm;
+#endif
+
+	/** whether to write the next variables directly from the user arrays */
+	int nocopy;
+
+	/** the number of dimensions of the chunks of the next variables (0 for
+	 * automatic) */
+	unsigned chunk_rank;
+
+	/** the dimensions of the chunks of the next variables */
+	hsize_t chunk_dims[MAX_RANK];
+
+	/** whether to write the next variables in chunked datasets */
+	int chunked;
+
+	/** the ah5_compression_t compression method of the next variables */
+	int compression;
+
+	/** the compression level of the next variables */
+	int compression_level;
+
+	/** whether to shuffle the next variables before compression */
+	int shuffle;
+
+	/** the AH5_STAGING_* flags used to allocate the staging buffers */
+	int staging_flags;
+
+	/** the maximum memory used by all staging buffers together (0 for none) */
+	size_t mem_limit;
+
+	/** the memory currently used by all staging buffers together */
+	size_t mem_used;
+
+	/** the ah5_backpressure_t policy applied when staging a command list
+	 * would exceed mem_limit */
+	int backpressure;
+
+	/** the directory of the scratch files of the spill policy, NULL for the
+	 * default temporary directory */
+	char* spill_dir;
+
+	/** whether the next variables are essential */
+	int essential;
+
+	/** whether the next variables are only written when they changed */
+	int delta;
+
+	/** the fingerprints of the variables written in delta mode, by bucket
+	 * of name, NULL until the mode is first enabled */
+	delta_t** deltas;
+
+	/** the external links written in delta mode that are still in place */
+	delta_link_t* delta_links;
+
+	/** the files that have been overwritten while linked into, never linked
+	 * into again */
+	delta_link_t* delta_reused;
+
+	/** the native type the next variables are converted to in the file, -1
+	 * to write them with their own type */
+	hid_t file_type;
+
+	/** the scale of the values of the next converted variables */
+	double file_scale;
+
+	/** the offset of the values of the next converted variables */
+	double file_offset;
+
+	/** the types of the user arrays looked up so far, replaced in turn */
+	type_info_t types[TYPE_CACHE_SIZE];
+
+	/** the next entry of the type cache to replace */
+	int next_type;
+
+	/** A spin lock held while the statistics of the instance or of its
+	 * command lists are updated or copied */
+	int stats_spin;
+
+	/** the I/O statistics cumulated since the initialization */
+	ah5_stats_t stats;
+
+	/** the I/O statistics of the last fully written command list */
+	ah5_stats_t last_stats;
+
+	/** the serial number of the last fully written command list */
+	uint64_t last_serial;
+
+	/** the file where to dump the statistics at finalization, NULL if none */
+	char* stats_file;
+
+	/** the ah5_stats_format_t format of the statistics file */
+	int stats_format;
+
+	/** the number of command lists finished by the user */
+	uint64_t nb_sealed;
+
+	/** the number of command lists fully written, updated atomically so that
+	 * it can be read without the mutex */
+	uint64_t nb_written;
+
+	/** the node-local directory where the files are written before being
+	 * drained to their final path, NULL to write them in place */
+	char* burst_dir;
+
+	/** the size of the files waiting in burst_dir above which the writer
+	 * threads wait before creating new ones */
+	size_t burst_capacity;
+
+	/** whether the files reach their final path in the order they were
+	 * created */
+	int burst_ordered;
+
+	/** the size of the files waiting in burst_dir */
+	size_t burst_used;
+
+	/** the ticket of the next file created in burst_dir */
+	uint64_t next_ticket;
+
+	/** the ticket of the next file to reach its final path in ordered mode */
+	uint64_t drained_ticket;
+
+	/** the files waiting to be drained, by increasing ticket */
+	drain_t* drains;
+
+	/** the number of files being drained */
+	int nb_draining;
+
+	/** a condition variable used to signal the drain threads that a file waits
+	 * or that the command has changed, and the others that a file has been
+	 * drained */
+	pthread_cond_t drain_cond;
+
+	/** the command to execute by the drain threads */
+	thread_command_t drain_cmd;
+
+	/** the threads draining the burst buffer */
+	pthread_t* drainers;
+
+	/** the number of drain threads */
+	int nb_drainers;
+
+	/** the priority of the instance in the shared scheduler, -1 if it does not
+	 * use it */
+	int sched_priority;
+
+	/** the number of bytes the shared scheduler let the instance write */
+	uint64_t sched_served;
+
+	/** the number of writer threads of the instance waiting for the shared
+	 * scheduler */
+	int sched_waiting;
+
+	/** the next instance using the shared scheduler */
+	struct ah5* sched_next;
+
+	/** the function called once each command list is complete, NULL if none */
+	ah5_callback_t callback;
+
+	/** the argument of callback */
+	void* callback_arg;
+
+};
+
+
+#define LOG_ERROR( ... ) do {\
+	if (__atomic_load_n(&(self->log_verbosity), __ATOMIC_RELAXED) >= VERBOSITY_ERROR) {\
+		FILE* out = self->log_file? self->log_file : stderr;\
+		fprintf(out, "*** Error: %s:%d: ", __FILE__, __LINE__);\
+		fprintf(out , ##__VA_ARGS__);\
+		fprintf(out, "\n");\
+		fflush(out);\
+	}\
+} while (0)
+
+
+
+#define LOG_WARNING( ... ) do {\
+	if (__atomic_load_n(&(self->log_verbosity), __ATOMIC_RELAXED) >= VERBOSITY_WARNING) {\
+		FILE* out = self->log_file? self->log_file : stderr;\
+		fprintf(out, "*** Warning: %s:%d: ", __FILE__, __LINE__);\
+		fprintf(out , ##__VA_ARGS__);\
+		fprintf(out, "\n");\
+		fflush(out);\
+	}\
+} while (0)
+
+
+#define LOG_STATUS( ... ) do {\
+	if (__atomic_load_n(&(self->log_verbosity), __ATOMIC_RELAXED) >= VERBOSITY_STATUS) {\
+		FILE* out = self->log_file? self->log_file : stderr;\
+		fprintf(out, "*** Status: %s:%d: ", __FILE__, __LINE__);\
+		fprintf(out , ##__VA_ARGS__);\
+		fprintf(out, "\n");\
+		fflush(out);\
+	}\
+} while (0)
+
+
+#ifndef NDEBUG
+#define LOG_DEBUG( ... ) do {\
+	if (__atomic_load_n(&(self->log_verbosity), __ATOMIC_RELAXED) >= VERBOSITY_DEBUG) {\
+		FILE* out = self->log_file? self->log_file : stderr;\
+		fprintf(out, "*** Log: %s:%d: ", __FILE__, __LINE__);\
+		fprintf(out , ##__VA_ARGS__);\
+		fprintf(out, "\n");\
+		fflush(out);\
+	}\
+} while (0)
+#else
+#define LOG_DEBUG( ... )
+#endif
+
+
+#define SIGNAL_ERROR do {\
+	int errno_save = errno;\
+	LOG_ERROR(" ----- Fatal: exiting -----\n");\
+	errno = errno_save;\
+	perror(NULL);\
+	exit(errno_save);\
+} while (0)
+
+
+#define RETURN_ERROR do {\
+	int errno_save = errno;\
+	LOG_WARNING(" ----- Leaving function -----\n");\
+	errno = errno_save;\
+	perror(NULL);\
+	errno = errno_save;\
+	return errno_save;\
+} while (0)
+
+
+/** Returns the number of microseconds elapsed since an arbitrary point, from
+ * a clock that is not affected by changes of the system time
+ * @returns the number of microseconds elapsed since an arbitrary point
+ */
+inline static int64_t clockget()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec*1000*1000 + ts.tv_nsec/1000;
+}
+
+
+/** The names of the ah5_phase_t phases in the statistics files
+ */
+static const char* const PHASE_NAMES[AH5_NB_PHASES] = {
+	"wait", "copy", "create", "write", "close", "sched", "read"
+};
+
+
+/** Acquires the lock protecting the statistics
+ * @param self a pointer to the instance state
+ */
+inline static void stats_lock( ah5_t self )
+{
+	while ( __atomic_exchange_n(&(self->stats_spin), 1, __ATOMIC_ACQUIRE) ) sched_yield();
+}
+
+
+/** Releases the lock protecting the statistics
+ * @param self a pointer to the instance state
+ */
+inline static void stats_unlock( ah5_t self )
+{
+	__atomic_store_n(&(self->stats_spin), 0, __ATOMIC_RELEASE);
+}
+
+
+/** Accounts for a measured duration in statistics
+ * @param stats the statistics
+ * @param phase the ah5_phase_t measured
+ * @param duration the duration in microseconds
+ * @pre the statistics lock is held
+ */
+static void stats_add( ah5_stats_t* stats, ah5_phase_t phase, int64_t duration )
+{
+	ah5_phase_stats_t* phase_stats = &(stats->phases[phase]);
+	uint64_t us = ( duration > 0 )? (uint64_t)duration : 0;
+	unsigned bucket = 0;
+	while ( bucket+1<AH5_HIST_BUCKETS && ( us >> (bucket+1) ) ) ++bucket;
+	++phase_stats->count;
+	phase_stats->total_us += us;
+	++phase_stats->histogram[bucket];
+	if ( us > phase_stats->max_us ) phase_stats->max_us = us;
+}
+
+
+/** Records the duration of a phase in the cumulative statistics and in those
+ * of a command list
+ * @param self a pointer to the instance state
+ * @param list the command list the phase belongs to, NULL if none
+ * @param phase the ah5_phase_t measured
+ * @param start_time the clockget() time at which the phase started
+ */
+static void stats_record( ah5_t self, cmd_list_t* list, ah5_phase_t phase, int64_t start_time )
+{
+	int64_t duration = clockget()-start_time;
+	/* the writer threads and the copy threads record concurrently, readers
+	 * copy consistent snapshots */
+	stats_lock(self);
+	stats_add(&(self->stats), phase, duration);
+	if ( list ) stats_add(&(list->stats), phase, duration);
+	stats_unlock(self);
+}
+
+
+/** Adds a value to a counter of the cumulative statistics and of those of a
+ * command list
+ */
+#define STATS_COUNT( self, list, counter, value ) do {\
+	stats_lock(self);\
+	(self)->stats.counter += (value);\
+	(list)->stats.counter += (value);\
+	stats_unlock(self);\
+} while (0)
+
+
+/** Computes the bandwidths and overlap of statistics from their counters
+ * @param stats the statistics
+ */
+static void stats_derive( ah5_stats_t* stats )
+{
+	uint64_t copy_us = stats->phases[AH5_PHASE_COPY].total_us;
+	stats->copy_bandwidth = copy_us? stats->bytes_copied*1e6/copy_us : 0;
+	stats->write_bandwidth = stats->io_us? stats->bytes_written*1e6/stats->io_us : 0;
+	stats->overlap = 0;
+	if ( stats->io_us > stats->blocked_us ) {
+		stats->overlap = 1 - (double)stats->blocked_us/stats->io_us;
+	}
+}
+
+#ifndef H5_HAVE_THREADSAFE
+/** A mutex serializing all calls to a HDF5 library that is not thread-safe,
+ * shared by all instances
+ */
+static pthread_mutex_t h5_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+/** The process-wide scheduler the instances can share, it arbitrates the I/O
+ * of their writer threads and bounds their staging memory together
+ */
+typedef struct scheduler {
+
+	/** a mutex controling access to the scheduler */
+	pthread_mutex_t mutex;
+
+	/** a condition variable used to signal that a grant or memory has been
+	 * released */
+	pthread_cond_t cond;
+
+	/** the maximum number of writer threads doing I/O at the same time */
+	int nb_slots;
+
+	/** the number of writer threads doing I/O */
+	int nb_busy;
+
+	/** the maximum staging memory of the command lists in flight (0 for
+	 * none) */
+	size_t mem_limit;
+
+	/** the staging memory of the command lists in flight */
+	size_t mem_inflight;
+
+	/** the instances using the scheduler */
+	struct ah5* members;
+
+} scheduler_t;
+
+
+/** The scheduler shared by all instances of the process */
+static scheduler_t scheduler = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 1, 0, 0, 0, NULL
+};
+
+
+/** Acquires the right to call the HDF5 library
+ * @returns 0 on success, non-null on error
+ */
+inline static int h5_lock()
+{
+#ifdef H5_HAVE_THREADSAFE
+	return 0;
+#else
+	return pthread_mutex_lock(&h5_mutex);
+#endif
+}
+
+
+/** Releases the right to call the HDF5 library
+ * @returns 0 on success, non-null on error
+ */
+inline static int h5_unlock()
+{
+#ifdef H5_HAVE_THREADSAFE
+	return 0;
+#else
+	return pthread_mutex_unlock(&h5_mutex);
+#endif
+}
+
+
+#ifdef AH5_HAVE_URING
+
+/** The default size of the buffers the small writes of the io_uring file
+ * driver are coalesced in
+ */
+#define URING_BUFFER_SIZE (1024*1024)
+
+
+/** The configuration of the io_uring file driver
+ */
+typedef struct uring_fapl {
+
+	/** the maximum number of writes in flight */
+	unsigned depth;
+
+	/** the size of the buffers the small writes are coalesced in */
+	size_t buffer_size;
+
+} uring_fapl_t;
+
+
+/** A write of the io_uring file driver
+ */
+typedef struct uring_slot {
+
+	/** the memory to write, either the coalescing buffer of the slot or the
+	 * memory of the caller */
+	struct iovec iov;
+
+	/** the offset of the write in the file */
+	haddr_t addr;
+
+	/** whether the write is in flight */
+	int busy;
+
+	/** the coalescing buffer of the slot */
+	char* buffer;
+
+} uring_slot_t;
+
+
+/** An io_uring instance mapped in memory
+ */
+typedef struct uring {
+
+	/** the file descriptor of the ring, -1 if none */
+	int fd;
+
+	/** the tail of the submission queue */
+	unsigned* sq_tail;
+
+	/** the mask of the submission queue indices */
+	unsigned* sq_mask;
+
+	/** the indirection array of the submission queue */
+	unsigned* sq_array;
+
+	/** the head of the completion queue */
+	unsigned* cq_head;
+
+	/** the tail of the completion queue */
+	unsigned* cq_tail;
+
+	/** the mask of the completion queue indices */
+	unsigned* cq_mask;
+
+	/** the submission queue entries */
+	struct io_uring_sqe* sqes;
+
+	/** the completion queue entries */
+	struct io_uring_cqe* cqes;
+
+	/** the mapping of the submission queue */
+	void* sq_map;
+
+	/** the size of the mapping of the submission queue */
+	size_t sq_map_size;
+
+	/** the mapping of the completion queue, the same as sq_map when the
+	 * kernel maps both at once */
+	void* cq_map;
+
+	/** the size of the mapping of the completion queue */
+	size_t cq_map_size;
+
+	/** the size of the mapping of the submission queue entries */
+	size_t sqes_size;
+
+} uring_t;
+
+
+/** A file opened with the io_uring file driver
+ */
+typedef struct uring_file {
+
+	/** the public part of the file, must come first */
+	H5FD_t pub;
+
+	/** the file descriptor */
+	int fd;
+
+	/** the device of the file */
+	dev_t device;
+
+	/** the inode of the file */
+	ino_t inode;
+
+	/** the end of the allocated address space */
+	haddr_t eoa;
+
+	/** the end of the data written */
+	haddr_t eof;
+
+	/** the configuration of the driver */
+	uring_fapl_t fa;
+
+	/** the ring, its fd is -1 if io_uring is not available */
+	uring_t ring;
+
+	/** the fa.depth write slots */
+	uring_slot_t* slots;
+
+	/** the indices of the free slots */
+	unsigned* free_slots;
+
+	/** the number of free slots */
+	unsigned nb_free;
+
+	/** the slot where small writes are being coalesced, -1 if none */
+	int pending;
+
+	/** whether the coalescing buffers are registered with the ring */
+	int fixed;
+
+	/** the errno of the first failed write, 0 if none */
+	int error;
+
+} uring_file_t;
+
+
+/** The identifier of the io_uring file driver once registered */
+static hid_t uring_driver = -1;
+
+
+/** Creates an io_uring instance
+ * @param ring the ring to initialize
+ * @param entries the number of entries of the submission queue
+ * @returns 0 on success, non-null on error
+ */
+static int uring_setup( uring_t* ring, unsigned entries )
+{
+	struct io_uring_params params;
+	int errno_save;
+	memset(&params, 0, sizeof(params));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+	if ( ring->fd < 0 ) return errno;
+	ring->sq_map_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+	ring->cq_map_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+	if ( params.features & IORING_FEAT_SINGLE_MMAP ) {
+		if ( ring->cq_map_size > ring->sq_map_size ) ring->sq_map_size = ring->cq_map_size;
+		ring->cq_map_size = ring->sq_map_size;
+	}
+	ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+			ring->fd, IORING_OFF_SQ_RING);
+	if ( ring->sq_map == MAP_FAILED ) goto err_close;
+	ring->cq_map = ring->sq_map;
+	if ( !(params.features & IORING_FEAT_SINGLE_MMAP) ) {
+		ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+				ring->fd, IORING_OFF_CQ_RING);
+		if ( ring->cq_map == MAP_FAILED ) goto err_sq;
+	}
+	ring->sqes_size = params.sq_entries*sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+			ring->fd, IORING_OFF_SQES);
+	if ( ring->sqes == MAP_FAILED ) goto err_cq;
+	ring->sq_tail = (unsigned*)((char*)ring->sq_map + params.sq_off.tail);
+	ring->sq_mask = (unsigned*)((char*)ring->sq_map + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned*)((char*)ring->sq_map + params.sq_off.array);
+	ring->cq_head = (unsigned*)((char*)ring->cq_map + params.cq_off.head);
+	ring->cq_tail = (unsigned*)((char*)ring->cq_map + params.cq_off.tail);
+	ring->cq_mask = (unsigned*)((char*)ring->cq_map + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)((char*)ring->cq_map + params.cq_off.cqes);
+	return 0;
+
+err_cq:
+	errno_save = errno;
+	if ( ring->cq_map != ring->sq_map ) munmap(ring->cq_map, ring->cq_map_size);
+	errno = errno_save;
+err_sq:
+	errno_save = errno;
+	munmap(ring->sq_map, ring->sq_map_size);
+	errno = errno_save;
+err_close:
+	errno_save = errno;
+	close(ring->fd);
+	ring->fd = -1;
+	errno = errno_save;
+	return errno;
+}
+
+
+/** Destroys an io_uring instance
+ * @param ring the ring
+ */
+static void uring_teardown( uring_t* ring )
+{
+	if ( ring->fd < 0 ) return;
+	munmap(ring->sqes, ring->sqes_size);
+	if ( ring->cq_map != ring->sq_map ) munmap(ring->cq_map, ring->cq_map_size);
+	munmap(ring->sq_map, ring->sq_map_size);
+	close(ring->fd);
+	ring->fd = -1;
+}
+
+
+/** Checks whether io_uring can be used by the process
+ * @returns 1 if it can, 0 otherwise
+ */
+static int uring_available( void )
+{
+	uring_t ring;
+	if ( uring_setup(&ring, 1) ) return 0;
+	uring_teardown(&ring);
+	return 1;
+}
+
+
+/** Writes a memory area synchronously
+ * @param fd the file descriptor
+ * @param buf the memory to write
+ * @param size the size of the memory
+ * @param addr the offset in the file
+ * @returns 0 on success, the errno of the failure otherwise
+ */
+static int uring_write_sync( int fd, const char* buf, size_t size, haddr_t addr )
+{
+	while ( size ) {
+		ssize_t written = pwrite(fd, buf, size, addr);
+		if ( written < 0 && errno == EINTR ) continue;
+		if ( written <= 0 ) return written? errno : EIO;
+		buf += written;
+		size -= written;
+		addr += written;
+	}
+	return 0;
+}
+
+
+/** Processes the completed writes of a file
+ * @param file the file
+ * @param wait whether to wait for at least one write to complete
+ * @returns 0 on success, non-null on error
+ */
+static int uring_reap( uring_file_t* file, int wait )
+{
+	uring_t* ring = &(file->ring);
+	unsigned head = *ring->cq_head;
+	unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	while ( wait && head == tail ) {
+		if ( syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+				&& errno != EINTR ) {
+			return errno;
+		}
+		tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	}
+	for ( ; head != tail; ++head ) {
+		struct io_uring_cqe* cqe = &(ring->cqes[head & *ring->cq_mask]);
+		uring_slot_t* slot = &(file->slots[cqe->user_data]);
+		int error = 0;
+		if ( cqe->res < 0 ) {
+			error = -cqe->res;
+		} else if ( (size_t)cqe->res < slot->iov.iov_len ) {
+			/* finish a short write synchronously */
+			error = uring_write_sync(file->fd, (char*)slot->iov.iov_base + cqe->res,
+					slot->iov.iov_len - cqe->res, slot->addr + cqe->res);
+		}
+		if ( error && !file->error ) file->error = error;
+		slot->busy = 0;
+		file->free_slots[file->nb_free++] = cqe->user_data;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	return 0;
+}
+
+
+/** Gets a free write slot, waits for a write to complete if needed
+ * @param file the file
+ * @returns the index of the slot, -1 on error
+ */
+static int uring_slot_get( uring_file_t* file )
+{
+	while ( !file->nb_free ) {
+		int error = uring_reap(file, 1);
+		if ( error ) {
+			file->error = error;
+			return -1;
+		}
+	}
+	return file->free_slots[--file->nb_free];
+}
+
+
+/** Submits the write of a slot, after the writes in flight it overlaps
+ * @param file the file
+ * @param sid the index of the slot
+ * @returns 0 on success, non-null on error
+ */
+static int uring_submit( uring_file_t* file, int sid )
+{
+	uring_t* ring = &(file->ring);
+	uring_slot_t* slot = &(file->slots[sid]);
+	struct io_uring_sqe* sqe;
+	unsigned tail, idx, ii;
+	/* writes in flight complete in any order */
+	for ( ii = 0; ii<file->fa.depth; ++ii ) {
+		uring_slot_t* other = &(file->slots[ii]);
+		while ( other->busy && other->addr < slot->addr+slot->iov.iov_len
+				&& slot->addr < other->addr+other->iov.iov_len ) {
+			if ( uring_reap(file, 1) ) return -1;
+		}
+	}
+	tail = *ring->sq_tail;
+	idx = tail & *ring->sq_mask;
+	sqe = &(ring->sqes[idx]);
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->fd = file->fd;
+	sqe->off = slot->addr;
+	sqe->user_data = sid;
+	if ( file->fixed && slot->iov.iov_base == slot->buffer ) {
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->addr = (uintptr_t)slot->iov.iov_base;
+		sqe->len = slot->iov.iov_len;
+		sqe->buf_index = sid;
+	} else {
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->addr = (uintptr_t)&(slot->iov);
+		sqe->len = 1;
+	}
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail+1, __ATOMIC_RELEASE);
+	slot->busy = 1;
+	while ( syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) < 0 ) {
+		if ( errno != EINTR && errno != EAGAIN && errno != EBUSY ) return -1;
+		/* make room in the completion queue */
+		if ( uring_reap(file, 0) ) return -1;
+	}
+	return 0;
+}
+
+
+/** Waits for all the writes of a file to complete
+ * @param file the file
+ * @returns 0 on success, -1 on error
+ */
+static herr_t uring_drain( uring_file_t* file )
+{
+	if ( file->ring.fd < 0 ) return file->error? -1 : 0;
+	if ( file->pending >= 0 ) {
+		int sid = file->pending;
+		file->pending = -1;
+		if ( uring_submit(file, sid) ) return -1;
+	}
+	while ( file->nb_free < file->fa.depth ) {
+		if ( uring_reap(file, 1) ) return -1;
+	}
+	if ( file->error ) {
+		errno = file->error;
+		return -1;
+	}
+	return 0;
+}
+
+
+/** Copies the configuration of the io_uring file driver
+ * @param fapl the configuration
+ * @returns the copy
+ */
+static void* uring_fapl_copy( const void* fapl )
+{
+	uring_fapl_t* copy = malloc(sizeof(uring_fapl_t));
+	memcpy(copy, fapl, sizeof(uring_fapl_t));
+	return copy;
+}
+
+
+/** Frees a copy of the configuration of the io_uring file driver
+ * @param fapl the configuration
+ * @returns 0
+ */
+static herr_t uring_fapl_free( void* fapl )
+{
+	free(fapl);
+	return 0;
+}
+
+
+/** Gets the configuration a file has been opened with
+ * @param _file the file
+ * @returns a copy of the configuration
+ */
+static void* uring_fapl_get( H5FD_t* _file )
+{
+	return uring_fapl_copy(&(((uring_file_t*)_file)->fa));
+}
+
+
+/** Opens a file with the io_uring file driver
+ * @param name the name of the file
+ * @param flags the H5F_ACC_* flags
+ * @param fapl_id the file access property list
+ * @param maxaddr the maximum address of the file
+ * @returns the file, NULL on error
+ */
+static H5FD_t* uring_open( const char* name, unsigned flags, hid_t fapl_id, haddr_t maxaddr )
+{
+	const uring_fapl_t* fa = H5Pget_driver_info(fapl_id);
+	int o_flags = ( flags & H5F_ACC_RDWR )? O_RDWR : O_RDONLY;
+	uring_file_t* file;
+	struct stat st;
+	char* buffers;
+	unsigned ii;
+	int fd;
+	(void)maxaddr;
+	if ( flags & H5F_ACC_TRUNC ) o_flags |= O_TRUNC;
+	if ( flags & H5F_ACC_CREAT ) o_flags |= O_CREAT;
+	if ( flags & H5F_ACC_EXCL ) o_flags |= O_EXCL;
+	fd = open(name, o_flags, 0666);
+	if ( fd < 0 ) return NULL;
+	if ( fstat(fd, &st) ) {
+		close(fd);
+		return NULL;
+	}
+	file = calloc(1, sizeof(uring_file_t));
+	file->fd = fd;
+	file->device = st.st_dev;
+	file->inode = st.st_ino;
+	file->eof = st.st_size;
+	file->fa.depth = fa? fa->depth : 1;
+	file->fa.buffer_size = fa? fa->buffer_size : URING_BUFFER_SIZE;
+	file->pending = -1;
+	if ( posix_memalign((void**)&buffers, IMAGE_ALIGNMENT, file->fa.depth*file->fa.buffer_size) ) {
+		close(fd);
+		free(file);
+		return NULL;
+	}
+	file->slots = calloc(file->fa.depth, sizeof(uring_slot_t));
+	file->free_slots = malloc(file->fa.depth*sizeof(unsigned));
+	for ( ii = 0; ii<file->fa.depth; ++ii ) {
+		file->slots[ii].buffer = buffers + ii*file->fa.buffer_size;
+		file->free_slots[ii] = file->fa.depth-1-ii;
+	}
+	file->nb_free = file->fa.depth;
+	/* write synchronously if the ring can not be created */
+	if ( uring_setup(&(file->ring), file->fa.depth) ) file->ring.fd = -1;
+	if ( file->ring.fd >= 0 ) {
+		struct iovec* iovs = malloc(file->fa.depth*sizeof(struct iovec));
+		for ( ii = 0; ii<file->fa.depth; ++ii ) {
+			iovs[ii].iov_base = file->slots[ii].buffer;
+			iovs[ii].iov_len = file->fa.buffer_size;
+		}
+		/* registration fails when it exceeds RLIMIT_MEMLOCK, the buffers are
+		 * then mapped at each write */
+		file->fixed = !syscall(__NR_io_uring_register, file->ring.fd, IORING_REGISTER_BUFFERS,
+				iovs, file->fa.depth);
+		free(iovs);
+	}
+	return &(file->pub);
+}
+
+
+/** Closes a file opened with the io_uring file driver
+ * @param _file the file
+ * @returns 0 on success, -1 on error
+ */
+static herr_t uring_close( H5FD_t* _file )
+{
+	uring_file_t* file = (uring_file_t*)_file;
+	herr_t result = uring_drain(file);
+	uring_teardown(&(file->ring));
+	if ( close(file->fd) ) result = -1;
+	free(file->slots[0].buffer);
+	free(file->slots);
+	free(file->free_slots);
+	free(file);
+	return result;
+}
+
+
+/** Compares two files opened with the io_uring file driver
+ * @param _f1 the first file
+ * @param _f2 the second file
+ * @returns a negative, null or positive value like strcmp
+ */
+static int uring_cmp( const H5FD_t* _f1, const H5FD_t* _f2 )
+{
+	const uring_file_t* f1 = (const uring_file_t*)_f1;
+	const uring_file_t* f2 = (const uring_file_t*)_f2;
+	if ( f1->device != f2->device ) return ( f1->device < f2->device )? -1 : 1;
+	if ( f1->inode != f2->inode ) return ( f1->inode < f2->inode )? -1 : 1;
+	return 0;
+}
+
+
+/** Gets the features of the io_uring file driver
+ * @param _file the file
+ * @param flags the H5FD_FEAT_* features
+ * @returns 0
+ */
+static herr_t uring_query( const H5FD_t* _file, unsigned long* flags )
+{
+	(void)_file;
+	/* let HDF5 gather the small writes before they reach the driver */
+	*flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA
+			| H5FD_FEAT_DATA_SIEVE | H5FD_FEAT_AGGREGATE_SMALLDATA;
+	return 0;
+}
+
+
+/** Gets the end of the allocated address space of a file
+ * @param _file the file
+ * @param type the type of memory
+ * @returns the end of the address space
+ */
+static haddr_t uring_get_eoa( const H5FD_t* _file, H5FD_mem_t type )
+{
+	(void)type;
+	return ((const uring_file_t*)_file)->eoa;
+}
+
+
+/** Sets the end of the allocated address space of a file
+ * @param _file the file
+ * @param type the type of memory
+ * @param addr the end of the address space
+ * @returns 0
+ */
+static herr_t uring_set_eoa( H5FD_t* _file, H5FD_mem_t type, haddr_t addr )
+{
+	(void)type;
+	((uring_file_t*)_file)->eoa = addr;
+	return 0;
+}
+
+
+/** Gets the end of the data of a file, including the writes in flight
+ * @param _file the file
+ * @param type the type of memory
+ * @returns the end of the data
+ */
+static haddr_t uring_get_eof( const H5FD_t* _file, H5FD_mem_t type )
+{
+	(void)type;
+	return ((const uring_file_t*)_file)->eof;
+}
+
+
+/** Gets the file descriptor of a file
+ * @param _file the file
+ * @param fapl the file access property list
+ * @param file_handle where to store a pointer to the file descriptor
+ * @returns 0
+ */
+static herr_t uring_get_handle( H5FD_t* _file, hid_t fapl, void** file_handle )
+{
+	(void)fapl;
+	*file_handle = &(((uring_file_t*)_file)->fd);
+	return 0;
+}
+
+
+/** Reads from a file once its writes in flight are complete
+ * @param _file the file
+ * @param type the type of memory
+ * @param dxpl the data transfer property list
+ * @param addr the offset in the file
+ * @param size the size to read
+ * @param buf where to read
+ * @returns 0 on success, -1 on error
+ */
+static herr_t uring_read( H5FD_t* _file, H5FD_mem_t type, hid_t dxpl, haddr_t addr,
+		size_t size, void* buf )
+{
+	uring_file_t* file = (uring_file_t*)_file;
+	(void)type;
+	(void)dxpl;
+	if ( uring_drain(file) ) return -1;
+	while ( size ) {
+		ssize_t nb_read = pread(file->fd, buf, size, addr);
+		if ( nb_read < 0 && errno == EINTR ) continue;
+		if ( nb_read < 0 ) return -1;
+		/* past the end of the file, the content is null */
+		if ( !nb_read ) {
+			memset(buf, 0, size);
+			break;
+		}
+		buf = (char*)buf + nb_read;
+		size -= nb_read;
+		addr += nb_read;
+	}
+	return 0;
+}
+
+
+/** Writes to a file, small writes are copied and coalesced with the adjacent
+ * ones, larger ones are split in up to depth writes in flight from the memory
+ * of the caller
+ * @param _file the file
+ * @param type the type of memory
+ * @param dxpl the data transfer property list
+ * @param addr the offset in the file
+ * @param size the size to write
+ * @param buf the memory to write
+ * @returns 0 on success, -1 on error
+ */
+static herr_t uring_write( H5FD_t* _file, H5FD_mem_t type, hid_t dxpl, haddr_t addr,
+		size_t size, const void* buf )
+{
+	uring_file_t* file = (uring_file_t*)_file;
+	size_t buffer_size = file->fa.buffer_size;
+	(void)type;
+	(void)dxpl;
+	if ( addr+size > file->eof ) file->eof = addr+size;
+	if ( file->ring.fd < 0 ) {
+		/* keep the first error for the flush and close */
+		int error = uring_write_sync(file->fd, buf, size, addr);
+		if ( error && !file->error ) file->error = error;
+		return error? -1 : 0;
+	}
+	if ( size < buffer_size ) {
+		uring_slot_t* slot = ( file->pending >= 0 )? &(file->slots[file->pending]) : NULL;
+		/* append to the pending write if contiguous */
+		if ( slot && addr == slot->addr+slot->iov.iov_len && slot->iov.iov_len+size <= buffer_size ) {
+			memcpy((char*)slot->iov.iov_base + slot->iov.iov_len, buf, size);
+			slot->iov.iov_len += size;
+			return 0;
+		}
+		if ( slot ) {
+			file->pending = -1;
+			if ( uring_submit(file, slot-file->slots) ) return -1;
+		}
+		file->pending = uring_slot_get(file);
+		if ( file->pending < 0 ) return -1;
+		slot = &(file->slots[file->pending]);
+		slot->addr = addr;
+		slot->iov.iov_base = slot->buffer;
+		slot->iov.iov_len = size;
+		memcpy(slot->buffer, buf, size);
+		return 0;
+	}
+	/* the pending write may overlap */
+	if ( file->pending >= 0 ) {
+		int sid = file->pending;
+		file->pending = -1;
+		if ( uring_submit(file, sid) ) return -1;
+	}
+	/* the memory of the caller is only valid until we return */
+	while ( size ) {
+		size_t count = ( size < buffer_size )? size : buffer_size;
+		int sid = uring_slot_get(file);
+		if ( sid < 0 ) return -1;
+		file->slots[sid].addr = addr;
+		file->slots[sid].iov.iov_base = (void*)buf;
+		file->slots[sid].iov.iov_len = count;
+		if ( uring_submit(file, sid) ) return -1;
+		buf = (const char*)buf + count;
+		size -= count;
+		addr += count;
+	}
+	return uring_drain(file);
+}
+
+
+/** Waits for the writes in flight of a file
+ * @param _file the file
+ * @param dxpl the data transfer property list
+ * @param closing whether the file is being closed
+ * @returns 0 on success, -1 on error
+ */
+static herr_t uring_flush( H5FD_t* _file, hid_t dxpl, hbool_t closing )
+{
+	(void)dxpl;
+	(void)closing;
+	return uring_drain((uring_file_t*)_file);
+}
+
+
+/** Truncates a file to its allocated address space
+ * @param _file the file
+ * @param dxpl the data transfer property list
+ * @param closing whether the file is being closed
+ * @returns 0 on success, -1 on error
+ */
+static herr_t uring_truncate( H5FD_t* _file, hid_t dxpl, hbool_t closing )
+{
+	uring_file_t* file = (uring_file_t*)_file;
+	(void)dxpl;
+	(void)closing;
+	if ( uring_drain(file) ) return -1;
+	if ( file->eoa != file->eof ) {
+		if ( ftruncate(file->fd, file->eoa) ) return -1;
+		file->eof = file->eoa;
+	}
+	return 0;
+}
+
+
+/** The io_uring file driver
+ */
+static const H5FD_class_t URING_CLASS = {
+#ifdef H5FD_CLASS_VERSION
+	.version = H5FD_CLASS_VERSION,
+	.value = 600,
+#endif
+	.name = "ah5_uring",
+	.maxaddr = (haddr_t)INT64_MAX,
+	.fc_degree = H5F_CLOSE_WEAK,
+	.fapl_size = sizeof(uring_fapl_t),
+	.fapl_get = uring_fapl_get,
+	.fapl_copy = uring_fapl_copy,
+	.fapl_free = uring_fapl_free,
+	.open = uring_open,
+	.close = uring_close,
+	.cmp = uring_cmp,
+	.query = uring_query,
+	.get_eoa = uring_get_eoa,
+	.set_eoa = uring_set_eoa,
+	.get_eof = uring_get_eof,
+	.get_handle = uring_get_handle,
+	.read = uring_read,
+	.write = uring_write,
+	.flush = uring_flush,
+	.truncate = uring_truncate,
+	.fl_map = H5FD_FLMAP_DICHOTOMY
+};
+
+#endif /* AH5_HAVE_URING */
+
+
+#if H5_VERS_MINOR > 8 || H5_VERS_MINOR == 8 && H5_VERS_RELEASE >= 14
+#define CLS_DSET_CREATE H5P_CLS_DATASET_CREATE_ID_g
+#else
+#define CLS_DSET_CREATE H5P_CLS_DATASET_CREATE_g
+#endif
+
+/** Gets the array the writer threads read a Data from
+ * @param data the Data
+ * @param dims the dimensions of the array
+ * @param lbounds the lower bounds of the part to write in the array
+ * @returns the array, either the user array or the staging buffer
+ * @pre the rows to read are staged
+ */
+static void* data_source( data_id_t* data, hsize_t* dims, hsize_t* lbounds )
+{
+	unsigned dim;
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		if ( data->staging ) {
+			/* only the part to write has been copied */
+			dims[dim] = data->ubounds[dim]-data->lbounds[dim];
+			lbounds[dim] = 0;
+		} else {
+			dims[dim] = data->dims[dim];
+			lbounds[dim] = data->lbounds[dim];
+		}
+	}
+	return data->staging? data->staging : data->buf;
+}
+
+
+/** Copies a block of a nD array in a chunk, the part of the chunk outside the
+ * block is left untouched
+ * @param chunk the destination chunk
+ * @param chunk_dims the dimensions of the chunk
+ * @param src the source array where the block is
+ * @param dims the dimensions of the source array
+ * @param start the first index of the block in each dimension
+ * @param count the size of the block in each dimension
+ * @param rank the number of dimensions of the array
+ * @param type_size the size in bytes of the elements in the array
+ */
+static void chunk_gather( void* chunk, hsize_t* chunk_dims, void* src, hsize_t* dims,
+		hsize_t* start, hsize_t* count, unsigned rank, size_t type_size )
+{
+	size_t chunk_block_size = type_size, src_block_size = type_size;
+	hsize_t ii;
+	unsigned dim;
+
+	if ( rank == 1 ) {
+		memcpy(chunk, ((char*)src)+start[0]*type_size, count[0]*type_size);
+		return;
+	}
+	for ( dim = 1; dim<rank; ++dim ) {
+		chunk_block_size *= chunk_dims[dim];
+		src_block_size *= dims[dim];
+	}
+	for ( ii = 0; ii<count[0]; ++ii ) {
+		chunk_gather(((char*)chunk)+ii*chunk_block_size, chunk_dims+1,
+				((char*)src)+(start[0]+ii)*src_block_size, dims+1, start+1, count+1,
+				rank-1, type_size);
+	}
+}
+
+
+/** Reorders the bytes of the elements of a chunk the way the HDF5 shuffle
+ * filter does, i.e. all first bytes, then all second bytes, etc.
+ * @param dest the shuffled chunk
+ * @param src the chunk to shuffle
+ * @param size the size of the chunk in bytes
+ * @param type_size the size in bytes of the elements in the chunk
+ */
+static void chunk_shuffle( void* dest, void* src, size_t size, size_t type_size )
+{
+	size_t nb_elem = size / type_size;
+	size_t byte, elem;
+	for ( byte = 0; byte<type_size; ++byte ) {
+		unsigned char* out = ((unsigned char*)dest) + byte*nb_elem;
+		unsigned char* in = ((unsigned char*)src) + byte;
+		for ( elem = 0; elem<nb_elem; ++elem ) {
+			out[elem] = in[elem*type_size];
+		}
+	}
+	/* the trailing bytes are left as is, like the HDF5 filter does */
+	memcpy(((char*)dest)+nb_elem*type_size, ((char*)src)+nb_elem*type_size, size-nb_elem*type_size);
+}
+
+
+/** Checks whether ah5 applies the filters of a Data itself and writes its
+ * chunks directly, or whether it lets HDF5 do it
+ * @param data the Data to check
+ * @returns whether the chunks of the Data are written directly
+ */
+static int data_direct_chunk( data_id_t* data )
+{
+	unsigned dim;
+	if ( !data->chunked ) return 0;
+	/* chunks can only be written directly if the process writes all of them */
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		if ( data->offset[dim]
+				|| data->global_dims[dim] != data->ubounds[dim]-data->lbounds[dim] ) return 0;
+	}
+	if ( !data->shuffle && data->compression == AH5_COMPRESS_NONE ) return 0;
+#ifdef DIRECT_CHUNK_WRITE
+	switch ( data->compression ) {
+	case AH5_COMPRESS_NONE:
+		return 1;
+#ifdef AH5_HAVE_ZLIB
+	case AH5_COMPRESS_DEFLATE:
+		return 1;
+#endif
+#ifdef AH5_HAVE_ZSTD
+	case AH5_COMPRESS_ZSTD:
+		return 1;
+#endif
+	default:
+		return 0;
+	}
+#else
+	return 0;
+#endif
+}
+
+
+/** Returns the maximum size of a filtered chunk
+ * @param data the Data the chunk belongs to
+ * @param size the size of the raw chunk in bytes
+ * @returns the maximum size of the filtered chunk in bytes
+ */
+static size_t chunk_filtered_bound( data_id_t* data, size_t size )
+{
+	switch ( data->compression ) {
+#ifdef AH5_HAVE_ZLIB
+	case AH5_COMPRESS_DEFLATE:
+		return compressBound(size);
+#endif
+#ifdef AH5_HAVE_ZSTD
+	case AH5_COMPRESS_ZSTD:
+		return ZSTD_compressBound(size);
+#endif
+	default:
+		return size;
+	}
+}
+
+
+/** Applies the filters of a Data to a chunk
+ * @param data the Data the chunk belongs to
+ * @param raw the raw chunk, overwritten
+ * @param size the size of the raw chunk in bytes
+ * @param tmp a buffer of size chunk_filtered_bound(data, size)
+ * @param out the filtered chunk, either raw or tmp
+ * @param out_size the size of the filtered chunk in bytes
+ * @returns the filter mask, i.e. a bit set for each filter of the pipeline
+ * that was not applied
+ */
+static uint32_t chunk_filter( data_id_t* data, void* raw, size_t size, void* tmp,
+		void** out, size_t* out_size )
+{
+	unsigned compress_filter = 0;
+	*out = raw;
+	*out_size = size;
+	if ( data->shuffle ) {
+		chunk_shuffle(tmp, raw, size, data->type_size);
+		memcpy(raw, tmp, size);
+		compress_filter = 1;
+	}
+	switch ( data->compression ) {
+#ifdef AH5_HAVE_ZLIB
+	case AH5_COMPRESS_DEFLATE: {
+		uLongf dest_len = compressBound(size);
+		if ( compress2(tmp, &dest_len, raw, size, data->compression_level) != Z_OK
+				|| dest_len >= size ) {
+			/* store the chunk uncompressed */
+			return 1u << compress_filter;
+		}
+		*out = tmp;
+		*out_size = dest_len;
+	} break;
+#endif
+#ifdef AH5_HAVE_ZSTD
+	case AH5_COMPRESS_ZSTD: {
+		size_t dest_len = ZSTD_compress(tmp, ZSTD_compressBound(size), raw, size,
+				data->compression_level);
+		if ( ZSTD_isError(dest_len) || dest_len >= size ) {
+			/* store the chunk uncompressed */
+			return 1u << compress_filter;
+		}
+		*out = tmp;
+		*out_size = dest_len;
+	} break;
+#endif
+	default:
+		break;
+	}
+	return 0;
+}
+
+
+/** Computes the final chunk dimensions of a Data
+ * @param data the Data
+ * @param count the size of the dataset in each dimension
+ */
+static void data_chunk_dims( data_id_t* data, hsize_t* count )
+{
+	unsigned dim;
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		if ( !count[dim] ) {
+			/* empty datasets are not worth chunking */
+			data->chunked = 0;
+			return;
+		}
+	}
+	if ( !data->chunk_dims[0] ) {
+		/* keep whole inner dimensions and split the first one */
+		size_t inner_size = data->type_size;
+		for ( dim = 1; dim<data->rank; ++dim ) {
+			data->chunk_dims[dim] = count[dim];
+			inner_size *= count[dim];
+		}
+		data->chunk_dims[0] = CHUNK_SIZE / inner_size;
+	}
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		if ( data->chunk_dims[dim] > count[dim] ) data->chunk_dims[dim] = count[dim];
+		if ( data->chunk_dims[dim] < 1 ) data->chunk_dims[dim] = 1;
+	}
+}
+
+
+/** Sets the filters of a chunked Data in a dataset creation property list
+ * @param self a pointer to the instance state
+ * @param data the Data
+ * @param plist_id the dataset creation property list
+ */
+static void data_filters( ah5_t self, data_id_t* data, hid_t plist_id )
+{
+	if ( data->shuffle && H5Pset_shuffle(plist_id) ) SIGNAL_ERROR;
+	if ( data->compression == AH5_COMPRESS_DEFLATE
+			&& H5Pset_deflate(plist_id, data->compression_level) ) SIGNAL_ERROR;
+	if ( data->compression == AH5_COMPRESS_ZSTD ) {
+		unsigned level = data->compression_level;
+		if ( H5Pset_filter(plist_id, H5Z_FILTER_ZSTD, H5Z_FLAG_OPTIONAL, 1, &level) ) SIGNAL_ERROR;
+	}
+}
+
+
+/** Builds the creation property list of the dataset of a Data
+ * @param self a pointer to the instance state
+ * @param data the Data, its chunk dimensions are computed if needed
+ * @returns the property list
+ */
+static hid_t data_plist( ah5_t self, data_id_t* data )
+{
+	hid_t plist_id = H5Pcreate(CLS_DSET_CREATE);
+	if ( data->chunked ) data_chunk_dims(data, data->global_dims);
+	if ( data->chunked ) {
+		if ( H5Pset_chunk(plist_id, data->rank, data->chunk_dims) ) SIGNAL_ERROR;
+		data_filters(self, data, plist_id);
+	} else {
+		if ( H5Pset_layout(plist_id, H5D_CONTIGUOUS) ) SIGNAL_ERROR;
+	}
+	return plist_id;
+}
+
+
+/** Describes the packing of a converted Data with the scale_factor and
+ * add_offset attributes of the CF conventions
+ * @param self a pointer to the instance state
+ * @param data the Data whose dataset has just been created
+ */
+static void data_attributes( ah5_t self, data_id_t* data )
+{
+	const char* names[2] = { "scale_factor", "add_offset" };
+	double values[2];
+	hid_t space_id, attr_id;
+	int ii;
+	if ( !data->convert.kernel ) return;
+	if ( data->convert.scale == 1 && data->convert.offset == 0 ) return;
+	values[0] = data->convert.scale;
+	values[1] = data->convert.offset;
+	space_id = H5Screate(H5S_SCALAR);
+	if ( space_id < 0 ) SIGNAL_ERROR;
+	for ( ii = 0; ii<2; ++ii ) {
+#if ( H5Acreate_vers == 2 )
+		attr_id = H5Acreate2(data->dset_id, names[ii], H5T_NATIVE_DOUBLE, space_id,
+				H5P_DEFAULT, H5P_DEFAULT);
+#else
+		attr_id = H5Acreate(data->dset_id, names[ii], H5T_NATIVE_DOUBLE, space_id,
+				H5P_DEFAULT);
+#endif
+		if ( attr_id < 0 ) SIGNAL_ERROR;
+		if ( H5Awrite(attr_id, H5T_NATIVE_DOUBLE, &(values[ii])) ) SIGNAL_ERROR;
+		if ( H5Aclose(attr_id) ) SIGNAL_ERROR;
+	}
+	if ( H5Sclose(space_id) ) SIGNAL_ERROR;
+}
+
+
+/** Creates the dataset of a Data in the file of its command list
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @param data the Data
+ */
+static void data_create( ah5_t self, cmd_list_t* list, data_id_t* data )
+{
+	hid_t space_id = data->space_id;
+	hid_t plist_id = data->plist_id;
+	if ( plist_id < 0 ) {
+		space_id = H5Screate_simple(data->rank, data->global_dims, NULL);
+		plist_id = data_plist(self, data);
+	}
+#if ( H5Dcreate_vers == 2 )
+	data->dset_id = H5Dcreate2(list->file_id, data->name, data->type,
+			space_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+#else
+	data->dset_id = H5Dcreate( list->file_id, data->name, data->type,
+			space_id, plist_id);
+#endif
+	if ( data->dset_id < 0 ) SIGNAL_ERROR;
+	data_attributes(self, data);
+	if ( data->plist_id < 0 ) {
+		if ( H5Pclose(plist_id) ) SIGNAL_ERROR;
+		if ( H5Sclose(space_id) ) SIGNAL_ERROR;
+	}
+}
+
+
+/** Opens or creates the extendible dataset of a Data in the series file of
+ * its command list and extends it up to the step of the list
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @param data the Data
+ */
+static void data_append( ah5_t self, cmd_list_t* list, data_id_t* data )
+{
+	hsize_t dims[MAX_RANK+1];
+	hsize_t max_dims[MAX_RANK+1];
+	hsize_t chunk_dims[MAX_RANK+1];
+	hid_t space_id, plist_id;
+	size_t chunk_size = data->type_size;
+	unsigned dim;
+
+	/* chunks are always needed by extendible datasets */
+	if ( data->rank ) {
+		data->chunked = 1;
+		data_chunk_dims(data, data->global_dims);
+	}
+	if ( H5Lexists(list->file_id, data->name, H5P_DEFAULT) > 0 ) {
+#if ( H5Dopen_vers == 2 )
+		data->dset_id = H5Dopen2(list->file_id, data->name, H5P_DEFAULT);
+#else
+		data->dset_id = H5Dopen(list->file_id, data->name);
+#endif
+		if ( data->dset_id < 0 ) SIGNAL_ERROR;
+		space_id = H5Dget_space(data->dset_id);
+		if ( H5Sget_simple_extent_ndims(space_id) != (int)data->rank+1 ) {
+			LOG_ERROR("data %s changed rank in the series", data->name);
+			SIGNAL_ERROR;
+		}
+		if ( H5Sget_simple_extent_dims(space_id, dims, NULL) < 0 ) SIGNAL_ERROR;
+		if ( H5Sclose(space_id) ) SIGNAL_ERROR;
+		if ( dims[0] < list->step+1 ) {
+			dims[0] = list->step+1;
+			if ( H5Dset_extent(data->dset_id, dims) ) SIGNAL_ERROR;
+		}
+		return;
+	}
+	/* the first dimension is the time */
+	dims[0] = list->step+1;
+	max_dims[0] = H5S_UNLIMITED;
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		dims[dim+1] = data->global_dims[dim];
+		max_dims[dim+1] = data->global_dims[dim];
+		chunk_dims[dim+1] = data->chunked? data->chunk_dims[dim] : 1;
+		chunk_size *= chunk_dims[dim+1];
+	}
+	/* group the steps of small Data so that chunks fill at least a page */
+	chunk_dims[0] = ( chunk_size < 4096 )? 4096 / chunk_size : 1;
+	space_id = H5Screate_simple(data->rank+1, dims, max_dims);
+	plist_id = H5Pcreate(CLS_DSET_CREATE);
+	if ( H5Pset_chunk(plist_id, data->rank+1, chunk_dims) ) SIGNAL_ERROR;
+	data_filters(self, data, plist_id);
+#if ( H5Dcreate_vers == 2 )
+	data->dset_id = H5Dcreate2(list->file_id, data->name, data->type,
+			space_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+#else
+	data->dset_id = H5Dcreate( list->file_id, data->name, data->type,
+			space_id, plist_id);
+#endif
+	if ( data->dset_id < 0 ) SIGNAL_ERROR;
+	data_attributes(self, data);
+	if ( H5Pclose(plist_id) ) SIGNAL_ERROR;
+	if ( H5Sclose(space_id) ) SIGNAL_ERROR;
+}
+
+
+/** Replaces the dataset of an unchanged Data by an external link to the
+ * dataset of the file holding its last copy
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @param data the Data
+ */
+static void data_link( ah5_t self, cmd_list_t* list, data_id_t* data )
+{
+	LOG_DEBUG("async HDF5 linking unchanged data %s to %s", data->name, data->link_target);
+	if ( H5Lcreate_external(data->link_target, data->name, list->file_id, data->name,
+			H5P_DEFAULT, H5P_DEFAULT) ) SIGNAL_ERROR;
+}
+
+
+/** Chooses where to create the file of a command list, in the burst buffer
+ * if there is one, once the files waiting there leave enough room
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @returns the path of the file to create
+ * @pre the instance mutex is not held
+ */
+static const char* burst_open( ah5_t self, cmd_list_t* list )
+{
+	const char* base;
+	if ( !self->burst_dir ) return list->file_name;
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	while ( self->burst_capacity && self->burst_used >= self->burst_capacity
+			&& ( self->drains || self->nb_draining ) ) {
+		LOG_STATUS("burst buffer full, waiting for drain threads");
+		if ( pthread_cond_wait(&(self->drain_cond), &(self->mutex)) ) SIGNAL_ERROR;
+	}
+	list->ticket = self->next_ticket++;
+	/* distinct files may have the same base name */
+	base = strrchr(list->file_name, '/');
+	base = base? base+1 : list->file_name;
+	list->local_name = malloc(strlen(self->burst_dir)+strlen(base)+32);
+	sprintf(list->local_name, "%s/ah5_%lu_%s", self->burst_dir, (unsigned long)list->ticket, base);
+	if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+	LOG_DEBUG("async HDF5 writing %s in the burst buffer", list->file_name);
+	return list->local_name;
+}
+
+
+/** Hands the closed file of a command list over to the drain threads
+ * @param self a pointer to the instance state
+ * @param list the command list, its file has been created in the burst buffer
+ * @param cancel whether to remove the file instead of draining it
+ * @pre the instance mutex is held
+ * @post the instance mutex is held
+ */
+static void burst_submit( ah5_t self, cmd_list_t* list, int cancel )
+{
+	drain_t* drain = malloc(sizeof(drain_t));
+	drain_t** pos = &(self->drains);
+	struct stat st;
+	drain->local_name = list->local_name;
+	drain->file_name = malloc(strlen(list->file_name)+1);
+	strcpy(drain->file_name, list->file_name);
+	drain->ticket = list->ticket;
+	drain->cancel = cancel;
+	drain->size = 0;
+	/* files built in memory may not have been written */
+	if ( stat(drain->local_name, &st) ) {
+		drain->cancel = 1;
+	} else {
+		drain->size = st.st_size;
+	}
+	list->local_name = NULL;
+	/* the drain threads take the oldest files first */
+	while ( *pos && (*pos)->ticket < drain->ticket ) pos = &((*pos)->next);
+	drain->next = *pos;
+	*pos = drain;
+	self->burst_used += drain->size;
+	if ( pthread_cond_broadcast(&(self->drain_cond)) ) SIGNAL_ERROR;
+}
+
+
+/** Copies a file with large sequential reads and writes
+ * @param self a pointer to the instance state
+ * @param src_name the file to copy
+ * @param dest_name the copy
+ * @returns 0 on success, non-null on error
+ */
+static int burst_copy( ah5_t self, const char* src_name, const char* dest_name )
+{
+	char* buf = malloc(DRAIN_BLOCK_SIZE);
+	int src = open(src_name, O_RDONLY);
+	int dest = open(dest_name, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	int err = 0;
+	if ( src == -1 || dest == -1 ) err = errno;
+	if ( !err ) posix_fadvise(src, 0, 0, POSIX_FADV_SEQUENTIAL);
+	while ( !err ) {
+		ssize_t count = read(src, buf, DRAIN_BLOCK_SIZE);
+		ssize_t offset = 0;
+		if ( count < 0 && errno == EINTR ) continue;
+		if ( count < 0 ) err = errno;
+		if ( count <= 0 ) break;
+		while ( !err && offset < count ) {
+			ssize_t written = write(dest, buf+offset, count-offset);
+			if ( written < 0 && errno != EINTR ) err = errno;
+			if ( written > 0 ) offset += written;
+		}
+	}
+	/* the copy in the burst buffer is removed afterwards */
+	if ( !err && fsync(dest) ) err = errno;
+	if ( src != -1 ) close(src);
+	if ( dest != -1 && close(dest) && !err ) err = errno;
+	free(buf);
+	if ( err ) {
+		LOG_ERROR("unable to copy %s to %s", src_name, dest_name);
+		errno = err;
+	}
+	return err;
+}
+
+
+/** Moves a file from the burst buffer to its final path, renaming it when
+ * both are on the same file system and copying it otherwise. In ordered mode,
+ * the file is first moved next to its final path and only renamed there once
+ * all the files created before it have been.
+ * @param self a pointer to the instance state
+ * @param drain the file to drain
+ */
+static void burst_drain( ah5_t self, drain_t* drain )
+{
+	char* tmp_name = malloc(strlen(drain->file_name)+sizeof(DRAIN_SUFFIX));
+	const char* moved_name = self->burst_ordered? tmp_name : drain->file_name;
+	int failed = 0;
+	int64_t start_time = clockget();
+	sprintf(tmp_name, "%s" DRAIN_SUFFIX, drain->file_name);
+	if ( drain->cancel ) {
+		if ( unlink(drain->local_name) && errno != ENOENT ) {
+			LOG_WARNING("unable to remove the dropped file %s", drain->local_name);
+		}
+	} else if ( rename(drain->local_name, moved_name) ) {
+		/* a partial copy never appears at the final path */
+		failed = ( errno != EXDEV || burst_copy(self, drain->local_name, tmp_name)
+				|| ( moved_name != tmp_name && rename(tmp_name, moved_name) ) );
+		if ( failed ) {
+			LOG_ERROR("unable to drain %s, it is kept at %s", drain->file_name, drain->local_name);
+			unlink(tmp_name);
+		} else {
+			unlink(drain->local_name);
+		}
+	}
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	self->burst_used -= drain->size;
+	if ( pthread_cond_broadcast(&(self->drain_cond)) ) SIGNAL_ERROR;
+	while ( self->burst_ordered && self->drained_ticket != drain->ticket ) {
+		if ( pthread_cond_wait(&(self->drain_cond), &(self->mutex)) ) SIGNAL_ERROR;
+	}
+	if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+	if ( self->burst_ordered && !drain->cancel && !failed
+			&& rename(tmp_name, drain->file_name) ) {
+		LOG_ERROR("unable to rename %s to %s", tmp_name, drain->file_name);
+	}
+	LOG_DEBUG("async HDF5 drained %s in %" PRId64 "us", drain->file_name, clockget()-start_time);
+	free(tmp_name);
+}
+
+
+/** The function executed by the drain threads
+ * @param self_void a pointer to the instance state as a void*
+ * @returns NULL
+ */
+static void* drainer_thread_loop( void* self_void )
+{
+	ah5_t self = self_void;
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	for (;;) {
+		drain_t* drain = self->drains;
+		/* in ordered mode, the oldest file must always find a thread */
+		if ( drain && ( !self->burst_ordered
+				|| drain->ticket < self->drained_ticket+self->nb_drainers ) ) {
+			self->drains = drain->next;
+			++self->nb_draining;
+			if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+			burst_drain(self, drain);
+			if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+			if ( self->burst_ordered ) ++self->drained_ticket;
+			--self->nb_draining;
+			if ( pthread_cond_broadcast(&(self->drain_cond)) ) SIGNAL_ERROR;
+			free(drain->local_name);
+			free(drain->file_name);
+			free(drain);
+			continue;
+		}
+		if ( self->drain_cmd == CMD_TERMINATE && !self->drains ) break;
+		if ( pthread_cond_wait(&(self->drain_cond), &(self->mutex)) ) SIGNAL_ERROR;
+	}
+	pthread_mutex_unlock(&(self->mutex));
+	return NULL;
+}
+
+
+/** Builds the name of the file of a series, the files after a rollover are
+ * numbered before the extension
+ * @param series the series
+ * @returns the file name, to free
+ */
+static char* series_file_name( series_t* series )
+{
+	char* name = malloc(strlen(series->file_name)+24);
+	char* ext = strrchr(series->file_name, '.');
+	if ( !series->index ) {
+		strcpy(name, series->file_name);
+	} else if ( ext && !strchr(ext, '/') ) {
+		sprintf(name, "%.*s.%d%s", (int)(ext-series->file_name), series->file_name,
+				series->index, ext);
+	} else {
+		sprintf(name, "%s.%d", series->file_name, series->index);
+	}
+	return name;
+}
+
+
+/** Creates the file and datasets of a sealed command list and splits the
+ * writing in blocks to share amongst the writer threads
+ * @param self a pointer to the instance state
+ * @param list the command list to open
+ * @returns the number of blocks to write, to be published under the instance
+ * mutex
+ */
+static size_t list_open( ah5_t self, cmd_list_t* list )
+{
+	const char* file_name = NULL;
+	size_t nb_list_blocks = 0;
+	size_t did;
+
+	if ( !list->early ) list->start_time = clockget();
+
+	if ( list->series ) {
+		/* the lists appending to a series may be opened concurrently */
+		if ( pthread_mutex_lock(&(list->series->mutex)) ) SIGNAL_ERROR;
+	}
+	if ( !list->early && !list->series ) file_name = burst_open(self, list);
+	if ( h5_lock() ) SIGNAL_ERROR;
+	if ( list->early ) {
+		/* the file has been created while the list was being filled */
+	} else if ( !list->series ) {
+		int64_t create_time = clockget();
+		list->file_id = H5Fcreate( file_name, H5F_ACC_TRUNC, H5P_DEFAULT, self->file_plist );
+		stats_record(self, list, AH5_PHASE_CREATE, create_time);
+	} else if ( list->series->file_id < 0 ) {
+		char* file_name = series_file_name(list->series);
+		int64_t create_time = clockget();
+		LOG_DEBUG("async HDF5 creating series file %s", file_name);
+		list->series->file_id = H5Fcreate( file_name, H5F_ACC_TRUNC, H5P_DEFAULT, self->file_plist );
+		list->file_id = list->series->file_id;
+		stats_record(self, list, AH5_PHASE_CREATE, create_time);
+		free(file_name);
+	} else {
+		list->file_id = list->series->file_id;
+	}
+	if ( list->file_id < 0 ) SIGNAL_ERROR;
+	for ( did=list->created; did<list->data_size; ++did ) {
+		data_id_t* data = &(list->data[did]);
+		int64_t create_time = clockget();
+		if ( data->dropped ) continue;
+		if ( data->linked ) {
+			data_link(self, list, data);
+			stats_record(self, list, AH5_PHASE_CREATE, create_time);
+			continue;
+		}
+		LOG_DEBUG("async HDF5 creating data[%lu]: %s of rank %u", (unsigned long)did, data->name, (unsigned)data->rank);
+		if ( list->series ) {
+			data_append(self, list, data);
+		} else {
+			data_create(self, list, data);
+		}
+		stats_record(self, list, AH5_PHASE_CREATE, create_time);
+	}
+	if ( h5_unlock() ) SIGNAL_ERROR;
+	if ( list->series ) {
+		if ( pthread_mutex_unlock(&(list->series->mutex)) ) SIGNAL_ERROR;
+	}
+
+	/* split each Data along its first dimension in blocks large enough to be
+	 * worth writing from distinct threads */
+	for ( did=0; did<list->data_size; ++did ) {
+		data_id_t* data = &(list->data[did]);
+		size_t data_size = data->type_size;
+		hsize_t nb_blocks = 1;
+		hsize_t count0 = 1;
+		hsize_t blk;
+		unsigned dim;
+		if ( data->written || data->dropped || data->linked ) {
+			data->pending_blocks = 0;
+			continue;
+		}
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			data_size *= data->ubounds[dim]-data->lbounds[dim];
+		}
+		if ( data->rank && !list->series && data_direct_chunk(data) ) {
+			/* one block per row of chunks, so that they are written by a single
+			 * thread each */
+			count0 = data->ubounds[0]-data->lbounds[0];
+			nb_blocks = (count0+data->chunk_dims[0]-1) / data->chunk_dims[0];
+		} else if ( data->rank && self->collective ) {
+			/* all processes must issue the same collective writes */
+			count0 = data->ubounds[0]-data->lbounds[0];
+		} else if ( data->rank ) {
+			count0 = data->ubounds[0]-data->lbounds[0];
+			nb_blocks = data_size / WRITE_BLOCK_SIZE;
+			/* a Data copied in the staging buffer is written block by block as
+			 * soon as each one is staged, otherwise there is no need for more
+			 * blocks than threads */
+			if ( !data->staging && nb_blocks > (hsize_t)self->nb_writers ) nb_blocks = self->nb_writers;
+			if ( nb_blocks > count0 ) nb_blocks = count0;
+			if ( nb_blocks < 1 ) nb_blocks = 1;
+		}
+		list->blocks = realloc(list->blocks, (nb_list_blocks+nb_blocks)*sizeof(write_block_t));
+		for ( blk = 0; blk<nb_blocks; ++blk ) {
+			write_block_t* block = &(list->blocks[nb_list_blocks++]);
+			block->did = did;
+			if ( data->rank && !list->series && data_direct_chunk(data) ) {
+				block->start = blk*data->chunk_dims[0];
+				block->count = data->chunk_dims[0];
+				if ( block->start+block->count > count0 ) block->count = count0-block->start;
+			} else {
+				block->start = count0*blk/nb_blocks;
+				block->count = count0*(blk+1)/nb_blocks - block->start;
+			}
+		}
+		data->pending_blocks = nb_blocks;
+	}
+	return nb_list_blocks;
+}
+
+
+/** Writes the chunks of one block of a Data, filtering them in the calling
+ * thread and handing them directly to HDF5
+ * @param self a pointer to the instance state
+ * @param data the Data the block belongs to
+ * @param block the block to write, made of full rows of chunks
+ */
+static void block_write_chunks( ah5_t self, data_id_t* data, write_block_t* block )
+{
+#ifdef DIRECT_CHUNK_WRITE
+	hsize_t count[MAX_RANK];
+	hsize_t offset[MAX_RANK];
+	hsize_t start[MAX_RANK];
+	hsize_t chunk_count[MAX_RANK];
+	size_t chunk_size = data->type_size;
+	hsize_t src_dims[MAX_RANK];
+	hsize_t src_lbounds[MAX_RANK];
+	void* src = data_source(data, src_dims, src_lbounds);
+	void *raw, *tmp;
+	unsigned dim;
+
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		count[dim] = data->ubounds[dim]-data->lbounds[dim];
+		chunk_size *= data->chunk_dims[dim];
+		offset[dim] = 0;
+	}
+	offset[0] = block->start;
+	raw = malloc(chunk_size);
+	tmp = malloc(chunk_filtered_bound(data, chunk_size));
+	LOG_DEBUG("async HDF5 compressing data[%lu]: %s from %lu, size %lu", (unsigned long)block->did, data->name, (unsigned long)block->start, (unsigned long)block->count);
+	/* iterate over the chunks of the row, the last dimension varying fastest */
+	for (;;) {
+		void* out;
+		size_t out_size;
+		uint32_t filter_mask;
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			start[dim] = src_lbounds[dim]+offset[dim];
+			chunk_count[dim] = data->chunk_dims[dim];
+			if ( offset[dim]+chunk_count[dim] > count[dim] ) chunk_count[dim] = count[dim]-offset[dim];
+		}
+		/* edge chunks are padded with zeroes */
+		memset(raw, 0, chunk_size);
+		chunk_gather(raw, data->chunk_dims, src, src_dims, start, chunk_count,
+				data->rank, data->type_size);
+		filter_mask = chunk_filter(data, raw, chunk_size, tmp, &out, &out_size);
+		if ( h5_lock() ) SIGNAL_ERROR;
+		if ( H5Dwrite_chunk(data->dset_id, H5P_DEFAULT, filter_mask, offset, out_size, out) ) SIGNAL_ERROR;
+		if ( h5_unlock() ) SIGNAL_ERROR;
+		/* next chunk */
+		for ( dim = data->rank-1; dim>0; --dim ) {
+			offset[dim] += data->chunk_dims[dim];
+			if ( offset[dim] < count[dim] ) break;
+			offset[dim] = 0;
+		}
+		if ( dim == 0 ) break;
+	}
+	free(tmp);
+	free(raw);
+#else
+	assert(0);
+#endif
+}
+
+
+/** Writes one block of a Data
+ * @param self a pointer to the instance state
+ * @param list the command list the block belongs to
+ * @param data the Data the block belongs to, possibly a copy of the command
+ * @param block the block to write
+ */
+static void block_write( ah5_t self, cmd_list_t* list, data_id_t* data, write_block_t* block )
+{
+	hid_t mem_space_id, space_id;
+	/* the datasets of a series have the time as first dimension */
+	unsigned time = list->series? 1 : 0;
+	hsize_t count[MAX_RANK+1];
+	hsize_t start[MAX_RANK+1];
+	hsize_t src_dims[MAX_RANK];
+	hsize_t src_lbounds[MAX_RANK];
+	void* src;
+	size_t block_size = data->type_size;
+	int64_t write_time = clockget();
+	unsigned dim;
+
+	for ( dim = 1; dim<data->rank; ++dim ) {
+		block_size *= data->ubounds[dim]-data->lbounds[dim];
+	}
+	if ( data->rank ) block_size *= block->count;
+	STATS_COUNT(self, list, bytes_written, block_size);
+	if ( data->rank && !self->collective && !list->series && data_direct_chunk(data) ) {
+		block_write_chunks(self, data, block);
+		stats_record(self, list, AH5_PHASE_WRITE, write_time);
+		return;
+	}
+	LOG_DEBUG("async HDF5 writing data[%lu]: %s from %lu, size %lu", (unsigned long)block->did, data->name, (unsigned long)block->start, (unsigned long)block->count);
+	src = data_source(data, src_dims, src_lbounds);
+	if ( h5_lock() ) SIGNAL_ERROR;
+	space_id = H5Dget_space(data->dset_id);
+	/* the memory space selects the block to write inside the whole array */
+	mem_space_id = H5Screate_simple(data->rank, src_dims, NULL);
+	if ( data->rank || time ) {
+		int empty = 0;
+		start[0] = list->step;
+		count[0] = 1;
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			start[time+dim] = data->offset[dim];
+			count[time+dim] = data->ubounds[dim]-data->lbounds[dim];
+		}
+		if ( data->rank ) {
+			start[time] += block->start;
+			count[time] = block->count;
+		}
+		for ( dim = 0; dim<time+data->rank; ++dim ) {
+			if ( !count[dim] ) empty = 1;
+		}
+		if ( empty ) {
+			/* the process still has to take part in collective writes */
+			if ( H5Sselect_none(space_id) ) SIGNAL_ERROR;
+			if ( H5Sselect_none(mem_space_id) ) SIGNAL_ERROR;
+		} else {
+			if ( H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) ) SIGNAL_ERROR;
+			for ( dim = 0; dim<data->rank; ++dim ) {
+				start[dim] = src_lbounds[dim];
+			}
+			if ( data->rank ) {
+				start[0] += block->start;
+				if ( H5Sselect_hyperslab(mem_space_id, H5S_SELECT_SET, start, NULL, count+time,
+						NULL) ) SIGNAL_ERROR;
+			}
+		}
+	}
+	if ( H5Dwrite(data->dset_id, data->type, mem_space_id, space_id, self->xfer_plist,
+			src) ) SIGNAL_ERROR;
+	if ( H5Sclose(mem_space_id) ) SIGNAL_ERROR;
+	if ( H5Sclose(space_id) ) SIGNAL_ERROR;
+	if ( h5_unlock() ) SIGNAL_ERROR;
+	stats_record(self, list, AH5_PHASE_WRITE, write_time);
+}
+
+
+/** Opens the file and datasets of a sealed loading command list and splits
+ * the reading in blocks to share amongst the writer threads
+ * @param self a pointer to the instance state
+ * @param list the command list to open
+ * @returns the number of blocks to read, to be published under the instance
+ * mutex
+ */
+static size_t list_open_load( ah5_t self, cmd_list_t* list )
+{
+	size_t nb_list_blocks = 0;
+	size_t did;
+
+	list->start_time = clockget();
+	LOG_DEBUG("async HDF5 opening file %s", list->file_name);
+	if ( h5_lock() ) SIGNAL_ERROR;
+	/* the file is only read, it does not need the settings of the written ones
+	 * unless it is shared by the processes of the communicator */
+	list->file_id = H5Fopen(list->file_name, H5F_ACC_RDONLY,
+			self->collective? self->file_plist : H5P_DEFAULT);
+	if ( list->file_id < 0 ) {
+		LOG_ERROR("unable to open %s for loading", list->file_name);
+		SIGNAL_ERROR;
+	}
+	stats_record(self, list, AH5_PHASE_CREATE, list->start_time);
+	for ( did=0; did<list->data_size; ++did ) {
+		data_id_t* data = &(list->data[did]);
+		int64_t open_time = clockget();
+		LOG_DEBUG("async HDF5 opening data[%lu]: %s of rank %u", (unsigned long)did, data->name, (unsigned)data->rank);
+		data->dset_id = H5Dopen2(list->file_id, data->name, H5P_DEFAULT);
+		if ( data->dset_id < 0 ) {
+			LOG_ERROR("unable to open dataset %s in %s", data->name, list->file_name);
+			SIGNAL_ERROR;
+		}
+		stats_record(self, list, AH5_PHASE_CREATE, open_time);
+	}
+	if ( h5_unlock() ) SIGNAL_ERROR;
+
+	/* split each Data along its first dimension as for writing, the first
+	 * Data issued are the first loaded */
+	for ( did=0; did<list->data_size; ++did ) {
+		data_id_t* data = &(list->data[did]);
+		size_t data_size = data->type_size;
+		hsize_t nb_blocks = 1;
+		hsize_t count0 = 1;
+		hsize_t blk;
+		unsigned dim;
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			data_size *= data->ubounds[dim]-data->lbounds[dim];
+		}
+		if ( data->rank ) count0 = data->ubounds[0]-data->lbounds[0];
+		if ( data->rank && !self->collective ) {
+			nb_blocks = data_size / WRITE_BLOCK_SIZE;
+			if ( nb_blocks > (hsize_t)self->nb_writers ) nb_blocks = self->nb_writers;
+			if ( nb_blocks > count0 ) nb_blocks = count0;
+			if ( nb_blocks < 1 ) nb_blocks = 1;
+		}
+		list->blocks = realloc(list->blocks, (nb_list_blocks+nb_blocks)*sizeof(write_block_t));
+		for ( blk = 0; blk<nb_blocks; ++blk ) {
+			write_block_t* block = &(list->blocks[nb_list_blocks++]);
+			block->did = did;
+			block->start = count0*blk/nb_blocks;
+			block->count = count0*(blk+1)/nb_blocks - block->start;
+		}
+		data->pending_blocks = nb_blocks;
+	}
+	return nb_list_blocks;
+}
+
+
+/** Reads one block of a loaded Data
+ * @param self a pointer to the instance state
+ * @param list the command list the block belongs to
+ * @param block the block to read
+ */
+static void block_read( ah5_t self, cmd_list_t* list, write_block_t* block )
+{
+	data_id_t* data = &(list->data[block->did]);
+	hid_t mem_space_id, space_id;
+	hsize_t count[MAX_RANK];
+	hsize_t start[MAX_RANK];
+	hsize_t dest_dims[MAX_RANK];
+	hsize_t dest_lbounds[MAX_RANK];
+	void* dest;
+	int64_t read_time = clockget();
+	unsigned dim;
+
+	LOG_DEBUG("async HDF5 reading data[%lu]: %s from %lu, size %lu", (unsigned long)block->did, data->name, (unsigned long)block->start, (unsigned long)block->count);
+	/* the destination is laid out as the source of a write */
+	dest = data_source(data, dest_dims, dest_lbounds);
+	if ( h5_lock() ) SIGNAL_ERROR;
+	space_id = H5Dget_space(data->dset_id);
+	mem_space_id = H5Screate_simple(data->rank, dest_dims, NULL);
+	if ( data->rank ) {
+		int empty = 0;
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			start[dim] = data->offset[dim];
+			count[dim] = data->ubounds[dim]-data->lbounds[dim];
+		}
+		start[0] += block->start;
+		count[0] = block->count;
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			if ( !count[dim] ) empty = 1;
+		}
+		if ( empty ) {
+			/* the process still has to take part in collective reads */
+			if ( H5Sselect_none(space_id) ) SIGNAL_ERROR;
+			if ( H5Sselect_none(mem_space_id) ) SIGNAL_ERROR;
+		} else {
+			if ( H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) ) SIGNAL_ERROR;
+			for ( dim = 0; dim<data->rank; ++dim ) {
+				start[dim] = dest_lbounds[dim];
+			}
+			start[0] += block->start;
+			if ( H5Sselect_hyperslab(mem_space_id, H5S_SELECT_SET, start, NULL, count,
+					NULL) ) SIGNAL_ERROR;
+		}
+	}
+	if ( H5Dread(data->dset_id, data->type, mem_space_id, space_id, self->xfer_plist,
+			dest) ) {
+		LOG_ERROR("unable to read data %s from %s", data->name, list->file_name);
+		SIGNAL_ERROR;
+	}
+	if ( H5Sclose(mem_space_id) ) SIGNAL_ERROR;
+	if ( H5Sclose(space_id) ) SIGNAL_ERROR;
+	if ( h5_unlock() ) SIGNAL_ERROR;
+	stats_record(self, list, AH5_PHASE_READ, read_time);
+}
+
+
+/** Acquires the lock protecting the commands of a list that is being filled
+ * @param list the command list
+ */
+inline static void list_lock_data( cmd_list_t* list )
+{
+	while ( __atomic_exchange_n(&(list->data_lock), 1, __ATOMIC_ACQUIRE) ) sched_yield();
+}
+
+
+/** Releases the lock protecting the commands of a list that is being filled
+ * @param list the command list
+ */
+inline static void list_unlock_data( cmd_list_t* list )
+{
+	__atomic_store_n(&(list->data_lock), 0, __ATOMIC_RELEASE);
+}
+
+
+/** Writes a whole Data from the user array before its command list is sealed
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @param data a copy of the Data, the command array may move meanwhile
+ * @param did the index of the Data in the command list
+ * @pre the dataset of the Data is created
+ */
+static void data_write_early( ah5_t self, cmd_list_t* list, data_id_t* data, size_t did )
+{
+	hsize_t count0 = data->rank? data->ubounds[0]-data->lbounds[0] : 1;
+	hsize_t step = count0;
+	write_block_t block;
+	/* chunks are written one row of chunks at a time */
+	if ( data->rank && data_direct_chunk(data) ) step = data->chunk_dims[0];
+	block.did = did;
+	block.start = 0;
+	do {
+		block.count = ( count0-block.start < step )? count0-block.start : step;
+		block_write(self, list, data, &block);
+		block.start += step;
+	} while ( block.start < count0 );
+}
+
+
+/** Creates the file of a command list that is being filled and the datasets
+ * of the commands submitted so far, Data that are not copied are written
+ * right away
+ * @param self a pointer to the instance state
+ * @param list the command list
+ */
+static void list_open_early( ah5_t self, cmd_list_t* list )
+{
+	size_t did;
+	if ( !list->early ) {
+		const char* file_name;
+		list->start_time = clockget();
+		file_name = burst_open(self, list);
+		LOG_DEBUG("async HDF5 creating file before the command list is sealed");
+		if ( h5_lock() ) SIGNAL_ERROR;
+		list->file_id = H5Fcreate( file_name, H5F_ACC_TRUNC, H5P_DEFAULT, self->file_plist );
+		if ( list->file_id < 0 ) SIGNAL_ERROR;
+		if ( h5_unlock() ) SIGNAL_ERROR;
+		stats_record(self, list, AH5_PHASE_CREATE, list->start_time);
+		list->early = 1;
+	}
+	while ( list->created < __atomic_load_n(&(list->submitted), __ATOMIC_ACQUIRE) ) {
+		data_id_t data;
+		int written = 0;
+		int64_t start_time = clockget();
+		did = list->created;
+		/* work on a copy of the command, the user thread must not wait for the
+		 * I/O to grow the command array */
+		list_lock_data(list);
+		data = list->data[did];
+		list_unlock_data(list);
+		if ( data.dropped ) {
+			list->created = did+1;
+			continue;
+		}
+		if ( data.delta ) {
+			/* whether the Data is written or linked is only known once the
+			 * list is sealed */
+			list->early_stopped = 1;
+			break;
+		}
+		LOG_DEBUG("async HDF5 creating data[%lu]: %s of rank %u", (unsigned long)did, data.name, (unsigned)data.rank);
+		if ( h5_lock() ) SIGNAL_ERROR;
+		data_create(self, list, &data);
+		if ( h5_unlock() ) SIGNAL_ERROR;
+		stats_record(self, list, AH5_PHASE_CREATE, start_time);
+		/* the user array can not change before it is released */
+		if ( data.nocopy ) {
+			data_write_early(self, list, &data, did);
+			start_time = clockget();
+			if ( h5_lock() ) SIGNAL_ERROR;
+			if ( H5Dclose(data.dset_id) ) SIGNAL_ERROR;
+			if ( h5_unlock() ) SIGNAL_ERROR;
+			stats_record(self, list, AH5_PHASE_CLOSE, start_time);
+			written = 1;
+		}
+		/* publish the outcome in the command array */
+		list_lock_data(list);
+		list->data[did].dset_id = data.dset_id;
+		list->data[did].chunked = data.chunked;
+		memcpy(list->data[did].chunk_dims, data.chunk_dims, sizeof(data.chunk_dims));
+		list->data[did].written = written;
+		list_unlock_data(list);
+		list->created = did+1;
+		if ( written ) {
+			if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+			list_lock_data(list);
+			list->data[did].released = 1;
+			list_unlock_data(list);
+			if ( pthread_cond_broadcast(&(self->free_cond)) ) SIGNAL_ERROR;
+			if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+		}
+	}
+}
+
+
+/** Writes a file image with large writes that bypass the page cache when the
+ * file system supports it
+ * @param self a pointer to the instance state
+ * @param image the image, aligned on IMAGE_ALIGNMENT and zero-padded to a
+ * multiple of it
+ * @param size the size of the file
+ * @param file_name the name of the file
+ */
+static void image_write( ah5_t self, void* image, size_t size, const char* file_name )
+{
+	size_t padded = (size+IMAGE_ALIGNMENT-1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+	size_t offset = 0;
+	/* the setting may have been reset since the file of a series was created */
+	size_t block_size = self->image_block? self->image_block : IMAGE_BLOCK_SIZE;
+	int direct = 1;
+	int fd = open(file_name, O_WRONLY|O_CREAT|O_TRUNC|O_DIRECT, 0666);
+	if ( fd == -1 && errno == EINVAL ) {
+		LOG_STATUS("direct I/O not supported for %s, writing through the page cache", file_name);
+		direct = 0;
+		fd = open(file_name, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	}
+	if ( fd == -1 ) SIGNAL_ERROR;
+	/* direct writes must cover whole aligned blocks, the padding is cut off
+	 * afterwards */
+	if ( !direct ) padded = size;
+	while ( offset < padded ) {
+		size_t count = padded-offset;
+		ssize_t written;
+		if ( count > block_size ) count = block_size;
+		written = pwrite(fd, ((char*)image)+offset, count, offset);
+		if ( written < 0 && errno == EINTR ) continue;
+		if ( written < 0 ) SIGNAL_ERROR;
+		offset += written;
+	}
+	if ( direct && padded != size && ftruncate(fd, size) ) SIGNAL_ERROR;
+	if ( self->image_sync && fsync(fd) ) SIGNAL_ERROR;
+	if ( close(fd) ) SIGNAL_ERROR;
+}
+
+
+/** Closes a file, files built in memory are then written to the disk
+ * @param self a pointer to the instance state
+ * @param file_id the file
+ * @param file_name the name of the file
+ */
+static void file_close( ah5_t self, hid_t file_id, const char* file_name )
+{
+	void* image = NULL;
+	ssize_t size = 0;
+	hid_t plist_id;
+	if ( h5_lock() ) SIGNAL_ERROR;
+	/* the file may have been created before the setting changed */
+	plist_id = H5Fget_access_plist(file_id);
+	if ( plist_id < 0 ) SIGNAL_ERROR;
+	if ( H5Pget_driver(plist_id) == H5FD_CORE ) {
+		if ( H5Fflush(file_id, H5F_SCOPE_LOCAL) ) SIGNAL_ERROR;
+		size = H5Fget_file_image(file_id, NULL, 0);
+		if ( size < 0 ) SIGNAL_ERROR;
+		if ( posix_memalign(&image, IMAGE_ALIGNMENT,
+				(size+IMAGE_ALIGNMENT-1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT + IMAGE_ALIGNMENT) ) {
+			SIGNAL_ERROR;
+		}
+		if ( H5Fget_file_image(file_id, image, size) < 0 ) SIGNAL_ERROR;
+		memset(((char*)image)+size, 0, IMAGE_ALIGNMENT);
+	}
+	if ( H5Pclose(plist_id) ) SIGNAL_ERROR;
+	if ( H5Fclose(file_id) ) SIGNAL_ERROR;
+	if ( h5_unlock() ) SIGNAL_ERROR;
+	/* the other writer threads can use HDF5 meanwhile */
+	if ( image ) {
+		LOG_DEBUG("async HDF5 writing %lu bytes file image", (unsigned long)size);
+		image_write(self, image, size, file_name);
+		free(image);
+	}
+}
+
+
+/** Marks a series as not appended to anymore
+ * @param series the series
+ * @returns the series if it has to be closed by the caller once the instance
+ * mutex is released, NULL if command lists still append to it
+ * @pre the instance mutex is held
+ */
+static series_t* series_retire( series_t* series )
+{
+	series->retired = 1;
+	return series->nb_lists? NULL : series;
+}
+
+
+/** Accounts for a command list appended to a series being fully written
+ * @param series the series
+ * @returns the series if it has to be closed by the caller once the instance
+ * mutex is released, NULL otherwise
+ * @pre the instance mutex is held
+ */
+static series_t* series_release( series_t* series )
+{
+	--series->nb_lists;
+	return ( series->retired && !series->nb_lists )? series : NULL;
+}
+
+
+/** Closes the file of a series and frees it
+ * @param self a pointer to the instance state
+ * @param series the series
+ * @pre no command list appends to the series anymore
+ */
+static void series_close( ah5_t self, series_t* series )
+{
+	if ( series->file_id >= 0 ) {
+		int64_t close_time = clockget();
+		char* file_name = series_file_name(series);
+		LOG_DEBUG("async HDF5 closing series file after %lu steps", (unsigned long)series->steps);
+		file_close(self, series->file_id, file_name);
+		free(file_name);
+		stats_record(self, NULL, AH5_PHASE_CLOSE, close_time);
+	}
+	pthread_mutex_destroy(&(series->mutex));
+	free(series->file_name);
+	free(series);
+}
+
+
+/** Chooses the series a sealed command list appends to, rolls over to a new
+ * file when the current one has reached its limits or has another name
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @returns a series to be closed by the caller once the instance mutex is
+ * released, NULL if none
+ * @pre the instance mutex is held
+ */
+static series_t* series_assign( ah5_t self, cmd_list_t* list )
+{
+	series_t* series = self->series;
+	series_t* retired = NULL;
+	size_t list_size = 0;
+	size_t ii;
+	int index = 0;
+
+	list->series = NULL;
+	if ( !list->append ) return NULL;
+	for ( ii = 0; ii<list->data_size; ++ii ) {
+		size_t data_size = list->data[ii].type_size;
+		unsigned dim;
+		if ( list->data[ii].dropped ) continue;
+		for ( dim = 0; dim<list->data[ii].rank; ++dim ) {
+			data_size *= list->data[ii].ubounds[dim]-list->data[ii].lbounds[dim];
+		}
+		list_size += data_size;
+	}
+	if ( series ) {
+		int same_name = !strcmp(series->file_name, list->file_name);
+		if ( !same_name
+				|| ( self->rollover_steps && series->steps >= (uint64_t)self->rollover_steps )
+				|| ( self->rollover_bytes && series->bytes >= self->rollover_bytes ) ) {
+			index = same_name? series->index+1 : 0;
+			retired = series_retire(series);
+			series = NULL;
+		}
+	}
+	if ( !series ) {
+		series = malloc(sizeof(series_t));
+		if ( pthread_mutex_init(&(series->mutex), NULL) ) SIGNAL_ERROR;
+		series->file_name = malloc(strlen(list->file_name)+1);
+		strcpy(series->file_name, list->file_name);
+		series->index = index;
+		series->file_id = -1;
+		series->steps = 0;
+		series->bytes = 0;
+		series->nb_lists = 0;
+		series->retired = 0;
+		self->series = series;
+	}
+	list->series = series;
+	list->step = series->steps++;
+	list->flush = self->flush_steps && ( list->step+1 ) % self->flush_steps == 0;
+	series->bytes += list_size;
+	++series->nb_lists;
+	return retired;
+}
+
+
+/** Returns the number of bytes of a block of a Data
+ * @param list the command list the block belongs to
+ * @param block the block
+ * @returns the number of bytes of the block
+ */
+static size_t block_bytes( cmd_list_t* list, write_block_t* block )
+{
+	data_id_t* data = &(list->data[block->did]);
+	size_t size = data->type_size;
+	unsigned dim;
+	if ( !data->rank ) return size;
+	size *= block->count;
+	for ( dim = 1; dim<data->rank; ++dim ) size *= data->ubounds[dim]-data->lbounds[dim];
+	return size;
+}
+
+
+/** Checks whether an instance is the one the shared scheduler serves next
+ * amongst those waiting: the highest priority first, then the one that has
+ * been served the least bytes
+ * @param self a pointer to the instance state
+ * @returns 1 if it is, 0 otherwise
+ * @pre the scheduler mutex is held
+ */
+static int sched_is_next( ah5_t self )
+{
+	ah5_t member;
+	for ( member = scheduler.members; member; member = member->sched_next ) {
+		if ( !member->sched_waiting || member == self ) continue;
+		if ( member->sched_priority > self->sched_priority ) return 0;
+		if ( member->sched_priority == self->sched_priority
+				&& member->sched_served < self->sched_served ) return 0;
+	}
+	return 1;
+}
+
+
+/** Waits for the shared scheduler to let a writer thread do I/O
+ * @param self a pointer to the instance state
+ * @param list the command list the I/O is for
+ * @returns 1 if the I/O has been granted and must be released, 0 if the
+ * instance does not use the shared scheduler
+ */
+static int sched_acquire( ah5_t self, cmd_list_t* list )
+{
+	int64_t start_time = clockget();
+	int waited = 0;
+	if ( __atomic_load_n(&(self->sched_priority), __ATOMIC_RELAXED) < 0 ) return 0;
+	if ( pthread_mutex_lock(&(scheduler.mutex)) ) SIGNAL_ERROR;
+	++self->sched_waiting;
+	while ( self->sched_priority >= 0
+			&& ( scheduler.nb_busy >= scheduler.nb_slots || !sched_is_next(self) ) ) {
+		waited = 1;
+		if ( pthread_cond_wait(&(scheduler.cond), &(scheduler.mutex)) ) SIGNAL_ERROR;
+	}
+	--self->sched_waiting;
+	/* the instance may have left the scheduler meanwhile */
+	if ( self->sched_priority < 0 ) {
+		if ( pthread_mutex_unlock(&(scheduler.mutex)) ) SIGNAL_ERROR;
+		return 0;
+	}
+	++scheduler.nb_busy;
+	if ( pthread_mutex_unlock(&(scheduler.mutex)) ) SIGNAL_ERROR;
+	if ( waited ) stats_record(self, list, AH5_PHASE_SCHED, start_time);
+	return 1;
+}
+
+
+/** Lets the shared scheduler grant I/O to another writer thread
+ * @param self a pointer to the instance state
+ * @param granted the value returned by sched_acquire
+ * @param bytes the number of bytes written with the grant
+ */
+static void sched_release( ah5_t self, int granted, size_t bytes )
+{
+	if ( !granted ) return;
+	if ( pthread_mutex_lock(&(scheduler.mutex)) ) SIGNAL_ERROR;
+	--scheduler.nb_busy;
+	self->sched_served += bytes;
+	if ( pthread_cond_broadcast(&(scheduler.cond)) ) SIGNAL_ERROR;
+	if ( pthread_mutex_unlock(&(scheduler.mutex)) ) SIGNAL_ERROR;
+}
+
+
+/** Releases the staging memory a written command list accounted for in the
+ * shared scheduler
+ * @param self a pointer to the instance state
+ * @param list the command list
+ */
+static void sched_retire( ah5_t self, cmd_list_t* list )
+{
+	if ( !list->sched_bytes ) return;
+	if ( pthread_mutex_lock(&(scheduler.mutex)) ) SIGNAL_ERROR;
+	scheduler.mem_inflight -= list->sched_bytes;
+	list->sched_bytes = 0;
+	if ( pthread_cond_broadcast(&(scheduler.cond)) ) SIGNAL_ERROR;
+	if ( pthread_mutex_unlock(&(scheduler.mutex)) ) SIGNAL_ERROR;
+}
+
+
+/** Makes an instance join or leave the shared scheduler
+ * @param self a pointer to the instance state
+ * @param priority the priority of the instance, negative to leave
+ * @returns 0 on success, non-null on error
+ */
+static int sched_join( ah5_t self, int priority )
+{
+	ah5_t* pos;
+	ah5_t member;
+	if ( pthread_mutex_lock(&(scheduler.mutex)) ) RETURN_ERROR;
+	for ( pos = &(scheduler.members); *pos && *pos != self; pos = &((*pos)->sched_next) );
+	if ( *pos && priority < 0 ) *pos = self->sched_next;
+	if ( !*pos && priority >= 0 ) {
+		/* start level with the others rather than ahead of all of them */
+		self->sched_served = 0;
+		for ( member = scheduler.members; member; member = member->sched_next ) {
+			if ( member == scheduler.members || member->sched_served < self->sched_served ) {
+				self->sched_served = member->sched_served;
+			}
+		}
+		self->sched_next = scheduler.members;
+		scheduler.members = self;
+	}
+	__atomic_store_n(&(self->sched_priority), priority < 0? -1 : priority, __ATOMIC_RELAXED);
+	/* the waiting threads of the instance and the others re-evaluate */
+	if ( pthread_cond_broadcast(&(scheduler.cond)) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(scheduler.mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+/** Closes the file of a fully written command list, or flushes the file of
+ * its series if needed, and releases its slot
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @pre the instance mutex is held
+ * @post the instance mutex is held
+ */
+static void list_close( ah5_t self, cmd_list_t* list )
+{
+	series_t* retired = NULL;
+	ah5_callback_t callback;
+	void* callback_arg;
+	size_t did;
+	int64_t close_time = clockget();
+	int64_t io_time;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+	if ( list->load ) {
+		LOG_DEBUG("async HDF5 closing loaded file");
+		if ( h5_lock() ) SIGNAL_ERROR;
+		if ( H5Fclose(list->file_id) ) SIGNAL_ERROR;
+		if ( h5_unlock() ) SIGNAL_ERROR;
+	} else if ( !list->series ) {
+		LOG_DEBUG("async HDF5 closing file");
+		file_close(self, list->file_id, list->local_name? list->local_name : list->file_name);
+	} else if ( list->flush ) {
+		LOG_DEBUG("async HDF5 flushing series file");
+		if ( h5_lock() ) SIGNAL_ERROR;
+		if ( H5Fflush(list->file_id, H5F_SCOPE_LOCAL) ) SIGNAL_ERROR;
+		if ( h5_unlock() ) SIGNAL_ERROR;
+	}
+	if ( !list->series || list->flush ) stats_record(self, list, AH5_PHASE_CLOSE, close_time);
+	io_time = clockget()-list->start_time;
+	LOG_DEBUG("async HDF5 write duration: %" PRId64 "us", io_time);
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	STATS_COUNT(self, list, lists, 1);
+	STATS_COUNT(self, list, io_us, (uint64_t)io_time);
+	stats_lock(self);
+	self->last_stats = list->stats;
+	stats_unlock(self);
+	self->last_serial = list->serial;
+	if ( list->series ) {
+		retired = series_release(list->series);
+		list->series = NULL;
+	}
+	if ( list->local_name ) burst_submit(self, list, 0);
+	callback = self->callback;
+	callback_arg = self->callback_arg;
+	if ( retired || callback ) {
+		if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+		if ( retired ) series_close(self, retired);
+		if ( callback ) {
+			callback((ah5_token_t)(list->serial << TOKEN_VAR_BITS), list->file_name, 0, callback_arg);
+		}
+		if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	}
+	sched_retire(self, list);
+	/* once the write list has been fully executed, release its slot */
+	list->state = LIST_FREE;
+	/* unless the user still reads Data loaded in its staging buffer */
+	for ( did = 0; list->load && did<list->data_size; ++did ) {
+		if ( list->data[did].staging ) list->state = LIST_LOADED;
+	}
+	__atomic_add_fetch(&(self->nb_written), 1, __ATOMIC_RELEASE);
+	/* and wake up the main thread potentially waiting for us */
+	if ( pthread_cond_broadcast(&(self->free_cond)) ) SIGNAL_ERROR;
+}
+
+
+/** Accounts for a written block, closes its dataset and file when they are
+ * complete
+ * @param self a pointer to the instance state
+ * @param list the command list the block belongs to
+ * @param block the block that has been written
+ * @pre the instance mutex is held
+ * @post the instance mutex is held
+ */
+static void block_done( ah5_t self, cmd_list_t* list, write_block_t* block )
+{
+	data_id_t* data = &(list->data[block->did]);
+	int data_complete = ( --data->pending_blocks == 0 );
+	int list_complete = ( --list->pending_blocks == 0 );
+	int64_t close_time;
+
+	if ( !data_complete ) return;
+	/* the user array is not needed anymore or has been loaded, tell whoever
+	 * waits for it */
+	if ( data->nocopy || list->load ) {
+		data->released = 1;
+		if ( pthread_cond_broadcast(&(self->free_cond)) ) SIGNAL_ERROR;
+	}
+	if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+	close_time = clockget();
+	if ( h5_lock() ) SIGNAL_ERROR;
+	if ( H5Dclose(data->dset_id) ) SIGNAL_ERROR;
+	if ( h5_unlock() ) SIGNAL_ERROR;
+	stats_record(self, list, AH5_PHASE_CLOSE, close_time);
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	if ( list_complete ) list_close(self, list);
+}
+
+
+/** Looks for a block that remains to be written in the command lists being
+ * written, oldest first, and whose data is available
+ * @param self a pointer to the instance state
+ * @returns the command list with a block to write or NULL if there is none
+ * @pre the instance mutex is held
+ */
+static cmd_list_t* find_pending_block( ah5_t self )
+{
+	size_t ii;
+	/* the lists are written in ring order, the oldest one is just after the
+	 * next one to open */
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		cmd_list_t* list = &(self->lists[(self->write_idx+ii)%self->nb_lists]);
+		write_block_t* block;
+		data_id_t* data;
+		if ( list->state != LIST_WRITING || list->next_block == list->nb_blocks ) continue;
+		/* the blocks are copied in the order they are written */
+		block = &(list->blocks[list->next_block]);
+		data = &(list->data[block->did]);
+		if ( data->staged || block->start+block->count <= data->staged_rows ) return list;
+	}
+	return NULL;
+}
+
+
+/** The function executed by the writer threads
+ * @param self_void a pointer to the instance state as a void*
+ * @returns NULL
+ */
+static void* writer_thread_loop( void* self_void )
+{
+	ah5_t self = self_void;
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
 	LOG_STATUS("async HDF5 thread started");
 	for (;;) {
-		int64_t start_time;
-		hid_t file_id;
-		size_t did;
+		cmd_list_t* list;
+
+		/* first help writing the command lists already opened */
+		list = find_pending_block(self);
+		if ( list ) {
+			write_block_t* block = &(list->blocks[list->next_block++]);
+			int granted;
+			if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+			granted = sched_acquire(self, list);
+			if ( list->load ) {
+				block_read(self, list, block);
+			} else {
+				block_write(self, list, &(list->data[block->did]), block);
+			}
+			sched_release(self, granted, block_bytes(list, block));
+			if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+			block_done(self, list, block);
+			continue;
+		}
+
+		/* then open the next sealed command list, in order */
+		list = &(self->lists[self->write_idx]);
+		if ( list->state == LIST_READY && !list->early_busy ) {
+			size_t nb_blocks;
+			series_t* retired;
+			int granted;
+			LOG_DEBUG("async HDF5 thread executing write command for slot %lu", (unsigned long)self->write_idx);
+			list->state = LIST_WRITING;
+			list->nb_blocks = 0;
+			list->next_block = 0;
+			self->write_idx = (self->write_idx+1) % self->nb_lists;
+			retired = series_assign(self, list);
+			if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+			if ( retired ) series_close(self, retired);
+			granted = sched_acquire(self, list);
+			nb_blocks = list->load? list_open_load(self, list) : list_open(self, list);
+			sched_release(self, granted, 0);
+			if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+			list->nb_blocks = nb_blocks;
+			list->pending_blocks = nb_blocks;
+			if ( nb_blocks ) {
+				/* let the other writer threads help */
+				if ( pthread_cond_broadcast(&(self->cond)) ) SIGNAL_ERROR;
+			} else {
+				list_close(self, list);
+			}
+			continue;
+		}
+
+		/* otherwise get a head start on the command list being filled, the
+		 * datasets of a series depend on the whole list and collective
+		 * operations must happen in the same order everywhere */
+		if ( list->state == LIST_FILLING && !list->early_busy && !list->append && !list->load
+				&& !list->early_stopped && !self->collective
+				&& list->created < __atomic_load_n(&(list->submitted), __ATOMIC_ACQUIRE) ) {
+			int granted;
+			list->early_busy = 1;
+			if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+			granted = sched_acquire(self, list);
+			list_open_early(self, list);
+			sched_release(self, granted, 0);
+			if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+			list->early_busy = 0;
+			/* the list may have been sealed meanwhile */
+			if ( pthread_cond_broadcast(&(self->cond)) ) SIGNAL_ERROR;
+			continue;
+		}
+
+		/* if there is nothing left to write and the command is to stop ... stop */
+		if ( self->thread_cmd == CMD_TERMINATE ) {
+			LOG_DEBUG("async HDF5 thread executing terminate command");
+			pthread_mutex_unlock(&(self->mutex));
+			return NULL;
+		}
+
+		/* otherwise ... wait for something to do */
+		if ( pthread_cond_wait(&(self->cond), &(self->mutex)) ) SIGNAL_ERROR;
+	}
+}
+
+
+/** The argument of a copy pool thread */
+typedef struct pool_thread_arg {
+
+	/** the pool */
+	copy_pool_t* pool;
+
+	/** the index of the thread in the pool */
+	int tid;
+
+	/** the number of the last job executed before the thread started */
+	uint64_t generation;
+
+} pool_thread_arg_t;
+
+
+/** The function executed by the threads of a copy pool
+ * @param arg_void the pool_thread_arg_t argument of the thread, to free
+ * @returns NULL
+ */
+static void* pool_thread_loop( void* arg_void )
+{
+	pool_thread_arg_t arg = *(pool_thread_arg_t*)arg_void;
+	copy_pool_t* pool = arg.pool;
+	ah5_t self = pool->self;
+	uint64_t generation = arg.generation;
+	free(arg_void);
+	if ( pthread_mutex_lock(&(pool->mutex)) ) SIGNAL_ERROR;
+	for (;;) {
+		while ( pool->generation == generation && !pool->terminate ) {
+			if ( pthread_cond_wait(&(pool->cond), &(pool->mutex)) ) SIGNAL_ERROR;
+		}
+		if ( pool->terminate ) break;
+		generation = pool->generation;
+		if ( pthread_mutex_unlock(&(pool->mutex)) ) SIGNAL_ERROR;
+		/* the thread posting the job executes part 0 */
+		pool->job(pool->job_arg, arg.tid+1, pool->nb_threads+1);
+		if ( pthread_mutex_lock(&(pool->mutex)) ) SIGNAL_ERROR;
+		if ( --pool->pending_parts == 0 ) {
+			if ( pthread_cond_broadcast(&(pool->done_cond)) ) SIGNAL_ERROR;
+		}
+	}
+	pthread_mutex_unlock(&(pool->mutex));
+	return NULL;
+}
+
+
+/** Starts the threads of a copy pool
+ * @param pool the pool with nb_threads and cpus set
+ * @returns 0 on success, non-null on error
+ */
+static int pool_start( copy_pool_t* pool )
+{
+	ah5_t self = pool->self;
+	int ii;
+	pool->job = NULL;
+	pool->terminate = 0;
+	pool->threads = malloc(pool->nb_threads*sizeof(pthread_t));
+	for ( ii = 0; ii<pool->nb_threads; ++ii ) {
+		pool_thread_arg_t* arg = malloc(sizeof(pool_thread_arg_t));
+		pthread_attr_t attr;
+		arg->pool = pool;
+		arg->tid = ii;
+		arg->generation = pool->generation;
+		if ( pthread_attr_init(&attr) ) RETURN_ERROR;
+		if ( pool->cpus ) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(pool->cpus[ii], &cpus);
+			if ( pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus) ) RETURN_ERROR;
+		}
+		if ( pthread_create(&(pool->threads[ii]), &attr, pool_thread_loop, arg) ) RETURN_ERROR;
+		if ( pthread_attr_destroy(&attr) ) RETURN_ERROR;
+	}
+	return 0;
+}
+
+
+/** Stops the threads of a copy pool
+ * @param pool the pool
+ * @returns 0 on success, non-null on error
+ */
+static int pool_stop( copy_pool_t* pool )
+{
+	ah5_t self = pool->self;
+	int ii;
+	if ( pthread_mutex_lock(&(pool->mutex)) ) RETURN_ERROR;
+	/* let the current job end */
+	while ( pool->job ) {
+		if ( pthread_cond_wait(&(pool->done_cond), &(pool->mutex)) ) RETURN_ERROR;
+	}
+	pool->terminate = 1;
+	if ( pthread_cond_broadcast(&(pool->cond)) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(pool->mutex)) ) RETURN_ERROR;
+	for ( ii = 0; ii<pool->nb_threads; ++ii ) {
+		if ( pthread_join(pool->threads[ii], NULL) ) RETURN_ERROR;
+	}
+	free(pool->threads);
+	pool->threads = NULL;
+	return 0;
+}
+
+
+/** Executes a job with the threads of a copy pool and the calling thread,
+ * jobs posted from multiple threads are executed one after the other
+ * @param pool the pool, NULL to execute the job in the calling thread only
+ * @param job the job
+ * @param arg the description of the job
+ */
+static void pool_run( copy_pool_t* pool, copy_job_t job, void* arg )
+{
+	ah5_t self;
+	if ( !pool || !pool->nb_threads ) {
+		job(arg, 0, 1);
+		return;
+	}
+	self = pool->self;
+	if ( pthread_mutex_lock(&(pool->mutex)) ) SIGNAL_ERROR;
+	while ( pool->job ) {
+		if ( pthread_cond_wait(&(pool->done_cond), &(pool->mutex)) ) SIGNAL_ERROR;
+	}
+	pool->job = job;
+	pool->job_arg = arg;
+	pool->pending_parts = pool->nb_threads;
+	++pool->generation;
+	if ( pthread_cond_broadcast(&(pool->cond)) ) SIGNAL_ERROR;
+	if ( pthread_mutex_unlock(&(pool->mutex)) ) SIGNAL_ERROR;
+	job(arg, 0, pool->nb_threads+1);
+	if ( pthread_mutex_lock(&(pool->mutex)) ) SIGNAL_ERROR;
+	while ( pool->pending_parts ) {
+		if ( pthread_cond_wait(&(pool->done_cond), &(pool->mutex)) ) SIGNAL_ERROR;
+	}
+	pool->job = NULL;
+	/* let the other threads waiting to post a job do it */
+	if ( pthread_cond_broadcast(&(pool->done_cond)) ) SIGNAL_ERROR;
+	if ( pthread_mutex_unlock(&(pool->mutex)) ) SIGNAL_ERROR;
+}
+
+
+/** Splits a memory area in page-aligned parts
+ * @param size the size of the area to split in bytes
+ * @param part the part to compute
+ * @param nb_parts the number of parts
+ * @param begin the displacement of the part
+ * @param end the displacement after the end of the part
+ */
+static void split_pages( size_t size, size_t part, size_t nb_parts, size_t* begin, size_t* end )
+{
+	size_t nb_pages = (size+4*1024-1) / (4*1024); /* size in pages (4k) rounded above */
+	*begin = nb_pages*part/nb_parts*(4*1024);
+	*end = nb_pages*(part+1)/nb_parts*(4*1024);
+	if ( *begin > size ) *begin = size;
+	if ( *end > size ) *end = size;
+}
+
+
+/** This function has the exact same prototype as memcpy and does the exact
+ * same thing, except it uses non-temporal stores that bypass the caches where
+ * supported
+ * @param dest the destination of the copy
+ * @param src the source of the copy
+ * @param size the number of bytes to copy
+ * @return a pointer to dest
+ * @post nt_fence must be called before the data is read by another thread
+ */
+static void* memcpy_nt( void* dest, const void* src, size_t size )
+{
+#ifdef __SSE2__
+	char* d = dest;
+	const char* s = src;
+	/* the stores must be aligned */
+	size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+	if ( head > size ) head = size;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	size -= head;
+	for ( ; size >= 64; size -= 64, d += 64, s += 64 ) {
+		__m128i x0 = _mm_loadu_si128((const __m128i*)s);
+		__m128i x1 = _mm_loadu_si128((const __m128i*)(s+16));
+		__m128i x2 = _mm_loadu_si128((const __m128i*)(s+32));
+		__m128i x3 = _mm_loadu_si128((const __m128i*)(s+48));
+		_mm_stream_si128((__m128i*)d, x0);
+		_mm_stream_si128((__m128i*)(d+16), x1);
+		_mm_stream_si128((__m128i*)(d+32), x2);
+		_mm_stream_si128((__m128i*)(d+48), x3);
+	}
+	memcpy(d, s, size);
+	return dest;
+#else
+	return memcpy(dest, src, size);
+#endif
+}
+
+
+/** Orders the non-temporal stores of the calling thread before its following
+ * stores
+ */
+inline static void nt_fence()
+{
+#ifdef __SSE2__
+	_mm_sfence();
+#endif
+}
+
+
+/** The description of a memory copy or set job */
+typedef struct mem_job {
+
+	/** the destination of the copy */
+	char* dest;
+
+	/** the source of the copy, NULL to set the memory */
+	const char* src;
+
+	/** the value to set */
+	int val;
+
+	/** the number of bytes */
+	size_t size;
+
+} mem_job_t;
+
+
+/** Executes a part of a memory copy or set job
+ * @param arg the mem_job_t description of the job
+ * @param part the part to execute
+ * @param nb_parts the number of parts
+ */
+static void mem_job( void* arg, size_t part, size_t nb_parts )
+{
+	mem_job_t* job = arg;
+	size_t begin, end;
+	split_pages(job->size, part, nb_parts, &begin, &end);
+	if ( !job->src ) {
+		memset(job->dest+begin, job->val, end-begin);
+	} else if ( job->size >= NT_COPY_SIZE ) {
+		memcpy_nt(job->dest+begin, job->src+begin, end-begin);
+		nt_fence();
+	} else {
+		memcpy(job->dest+begin, job->src+begin, end-begin);
+	}
+}
+
+
+/** This function has the same prototype as memcpy with an additional pool
+ * and does the exact same thing, except it does it in parallel
+ * @param pool the threads to copy with
+ * @param dest the destination of the copy
+ * @param src the source of the copy
+ * @param size the number of bytes to copy
+ * @return a pointer to dest
+ */
+static void* memcpy_par( copy_pool_t* pool, void* dest, const void* src, size_t size )
+{
+	mem_job_t job;
+	job.dest = dest;
+	job.src = src;
+	job.size = size;
+	pool_run(pool, mem_job, &job);
+	return dest;
+}
+
+
+/** This function has the same prototype as memset with an additional pool
+ * and does the exact same thing, except it does it in parallel with the same
+ * distribution of pages amongst threads as memcpy_par so that pages are first
+ * touched by the thread that will later copy into them
+ * @param pool the threads to set the memory with
+ * @param dest the memory to set
+ * @param val the value to set
+ * @param size the number of bytes to set
+ * @return a pointer to dest
+ */
+static void* memset_par( copy_pool_t* pool, void* dest, int val, size_t size )
+{
+	mem_job_t job;
+	job.dest = dest;
+	job.src = NULL;
+	job.val = val;
+	job.size = size;
+	pool_run(pool, mem_job, &job);
+	return dest;
+}
+
+
+/** Releases the memory of a staging arena
+ * @param self a pointer to the instance state
+ * @param arena the staging arena
+ */
+static void arena_release( ah5_t self, staging_arena_t* arena )
+{
+	if ( !arena->capacity ) return;
+	munmap(arena->base, arena->capacity);
+	if ( !arena->spilled ) self->mem_used -= arena->capacity;
+	arena->base = NULL;
+	arena->capacity = 0;
+	arena->spilled = 0;
+}
+
+
+/** Returns the size of the pages of the staging arenas
+ * @param self a pointer to the instance state
+ * @returns the size of the pages
+ */
+static size_t arena_page_size( ah5_t self )
+{
+	if ( self->staging_flags & (AH5_STAGING_HUGETLB|AH5_STAGING_HUGEPAGES) ) {
+		return HUGE_PAGE_SIZE;
+	}
+	return sysconf(_SC_PAGESIZE);
+}
+
+
+/** Checks whether a staging arena can be made large enough in memory without
+ * exceeding the memory limit
+ * @param self a pointer to the instance state
+ * @param arena the staging arena
+ * @param size the minimum size of the arena
+ * @returns 1 if it can, 0 otherwise
+ */
+static int arena_fits( ah5_t self, staging_arena_t* arena, size_t size )
+{
+	size_t page_size = arena_page_size(self);
+	size_t others = self->mem_used - ( arena->spilled? 0 : arena->capacity );
+	size_t capacity = (size+page_size-1) / page_size * page_size;
+	if ( !self->mem_limit ) return 1;
+	/* an arena large enough is kept as is */
+	if ( size <= arena->capacity && !arena->spilled ) capacity = arena->capacity;
+	return others + capacity <= self->mem_limit;
+}
+
+
+/** Maps a staging arena from an unlinked scratch file, its pages can then be
+ * written back to the disk instead of occupying memory
+ * @param self a pointer to the instance state
+ * @param arena the released staging arena
+ * @param capacity the size of the arena
+ * @returns 0 on success, non-null on error
+ */
+static int arena_spill( ah5_t self, staging_arena_t* arena, size_t capacity )
+{
+	const char* dir = self->spill_dir? self->spill_dir : P_tmpdir;
+	char* path = malloc(strlen(dir)+sizeof("/ah5_spill_XXXXXX"));
+	void* base = MAP_FAILED;
+	int errno_save;
+	int fd;
+	sprintf(path, "%s/ah5_spill_XXXXXX", dir);
+	fd = mkstemp(path);
+	if ( fd == -1 ) {
+		errno_save = errno;
+		LOG_ERROR("unable to create a scratch file in %s", dir);
+		free(path);
+		errno = errno_save;
+		return errno;
+	}
+	/* the file disappears with its last mapping */
+	unlink(path);
+	free(path);
+	if ( !ftruncate(fd, capacity) ) {
+		base = mmap(NULL, capacity, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	errno_save = errno;
+	close(fd);
+	if ( base == MAP_FAILED ) {
+		errno = errno_save;
+		return errno;
+	}
+	arena->base = base;
+	arena->capacity = capacity;
+	arena->spilled = 1;
+	LOG_DEBUG("staging buffer spilled to a %lu bytes scratch file", (unsigned long)capacity);
+	return 0;
+}
+
+
+/** Ensures a staging arena is large enough, its content is not preserved
+ * when it grows
+ * @param self a pointer to the instance state
+ * @param arena the staging arena
+ * @param size the minimum size of the arena
+ * @param spill whether to map the arena from a scratch file
+ * @returns 0 on success, non-null on error
+ */
+static int arena_reserve( ah5_t self, staging_arena_t* arena, size_t size, int spill )
+{
+	size_t page_size = arena_page_size(self);
+	size_t capacity;
+	void* base = MAP_FAILED;
+
+	if ( size <= arena->capacity && arena->spilled == spill ) return 0;
+
+	/* grow geometrically to amortize mappings when the size varies */
+	capacity = 2*arena->capacity;
+	if ( capacity < size ) capacity = size;
+	capacity = (capacity+page_size-1) / page_size * page_size;
+	if ( spill ) {
+		arena_release(self, arena);
+		return arena_spill(self, arena, capacity);
+	}
+	/* stay below the memory limit, possibly without geometric growth */
+	if ( self->mem_limit ) {
+		size_t others = self->mem_used - ( arena->spilled? 0 : arena->capacity );
+		if ( others + capacity > self->mem_limit ) {
+			capacity = (size+page_size-1) / page_size * page_size;
+		}
+		if ( others + capacity > self->mem_limit ) {
+			LOG_ERROR("staging %lu bytes would exceed the memory limit of %lu bytes",
+					(unsigned long)(others + capacity), (unsigned long)self->mem_limit);
+			errno = ENOMEM;
+			return ENOMEM;
+		}
+	}
+	arena_release(self, arena);
+
+#ifdef MAP_HUGETLB
+	if ( self->staging_flags & AH5_STAGING_HUGETLB ) {
+		base = mmap(NULL, capacity, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if ( base == MAP_FAILED ) {
+			LOG_WARNING("unable to map huge pages for staging, using regular pages");
+		}
+	}
+#endif
+	if ( base == MAP_FAILED ) {
+		base = mmap(NULL, capacity, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if ( base == MAP_FAILED ) return errno;
+#ifdef MADV_HUGEPAGE
+		if ( self->staging_flags & AH5_STAGING_HUGEPAGES ) {
+			if ( madvise(base, capacity, MADV_HUGEPAGE) ) {
+				LOG_WARNING("unable to use transparent huge pages for staging");
+			}
+		}
+#endif
+	}
+	arena->base = base;
+	arena->capacity = capacity;
+	self->mem_used += capacity;
+
+	if ( self->staging_flags & AH5_STAGING_MLOCK ) {
+		if ( mlock(base, capacity) ) {
+			LOG_WARNING("unable to lock %lu bytes of staging memory", (unsigned long)capacity);
+		}
+	}
+	if ( self->staging_flags & AH5_STAGING_PRETOUCH ) {
+		/* first touch the pages from the threads that will copy in them */
+		memset_par(&(self->pool), base, 0, capacity);
+	}
+	LOG_DEBUG("staging buffer grown to %lu bytes", (unsigned long)capacity);
+	return 0;
+}
+
+
+/** Defines a kernel converting elements to a floating-point type
+ */
+#define DEFINE_CONVERT_FLOAT(NAME, SRC, DEST) \
+static void convert_##NAME( void* dest, const void* src, size_t nb, double scale, \
+		double offset ) \
+{ \
+	DEST* restrict out = dest; \
+	const SRC* restrict in = src; \
+	double inv_scale = 1/scale; \
+	size_t ii; \
+	for ( ii = 0; ii<nb; ++ii ) out[ii] = (DEST)((in[ii]-offset)*inv_scale); \
+}
+DEFINE_CONVERT_FLOAT(double_float, double, float)
+
+
+/** Defines a kernel converting elements to an integer type, rounding to the
+ * nearest, saturating out of range values and storing NaN as 0
+ */
+#define DEFINE_CONVERT_INT(NAME, SRC, DEST, MIN, MAX) \
+static void convert_##NAME( void* dest, const void* src, size_t nb, double scale, \
+		double offset ) \
+{ \
+	DEST* restrict out = dest; \
+	const SRC* restrict in = src; \
+	double inv_scale = 1/scale; \
+	size_t ii; \
+	for ( ii = 0; ii<nb; ++ii ) { \
+		double val = (in[ii]-offset)*inv_scale; \
+		if ( val != val ) { \
+			out[ii] = 0; \
+		} else if ( val <= (MIN) ) { \
+			out[ii] = (MIN); \
+		} else if ( val >= (MAX) ) { \
+			out[ii] = (MAX); \
+		} else { \
+			out[ii] = (DEST)( val<0? val-0.5 : val+0.5 ); \
+		} \
+	} \
+}
+DEFINE_CONVERT_INT(double_short, double, short, SHRT_MIN, SHRT_MAX)
+DEFINE_CONVERT_INT(double_int, double, int, INT_MIN, INT_MAX)
+DEFINE_CONVERT_INT(float_short, float, short, SHRT_MIN, SHRT_MAX)
+DEFINE_CONVERT_INT(float_int, float, int, INT_MIN, INT_MAX)
+
+
+/** Finds the kernel converting elements from the type of a user array to a
+ * type written in the file
+ * @param mem_type the HDF5 type of the user array
+ * @param file_type the native HDF5 type written in the file
+ * @returns the kernel or NULL if the conversion is not supported
+ * @pre the HDF5 lock is held
+ */
+static convert_kernel_t convert_find( hid_t mem_type, hid_t file_type )
+{
+	int from_double = ( H5Tequal(mem_type, H5T_NATIVE_DOUBLE) > 0 );
+	int from_float = ( H5Tequal(mem_type, H5T_NATIVE_FLOAT) > 0 );
+	if ( H5Tequal(file_type, H5T_NATIVE_FLOAT) > 0 ) {
+		return from_double? convert_double_float : NULL;
+	}
+	if ( H5Tequal(file_type, H5T_NATIVE_SHORT) > 0 ) {
+		return from_double? convert_double_short : from_float? convert_float_short : NULL;
+	}
+	if ( H5Tequal(file_type, H5T_NATIVE_INT) > 0 ) {
+		return from_double? convert_double_int : from_float? convert_float_int : NULL;
+	}
+	return NULL;
+}
+
+
+/** Gets the size of a type of user array and its conversion to a file type,
+ * only calling HDF5 the first time
+ * @param self a pointer to the instance state
+ * @param type the HDF5 type of the user array
+ * @param file_type the native HDF5 type written in the file, -1 if none
+ * @returns the type information, NULL on error
+ */
+static type_info_t* type_lookup( ah5_t self, hid_t type, hid_t file_type )
+{
+	type_info_t* info;
+	int ii;
+	for ( ii = 0; ii<TYPE_CACHE_SIZE; ++ii ) {
+		info = &(self->types[ii]);
+		if ( info->type == type && info->file_type == file_type ) return info;
+	}
+	info = &(self->types[self->next_type]);
+	if ( h5_lock() ) return NULL;
+	info->size = H5Tget_size(type);
+	info->same = ( file_type < 0 || H5Tequal(type, file_type) > 0 );
+	info->kernel = ( file_type < 0 )? NULL : convert_find(type, file_type);
+	info->file_size = ( file_type < 0 )? 0 : H5Tget_size(file_type);
+	if ( h5_unlock() ) return NULL;
+	if ( !info->size ) {
+		errno = EINVAL;
+		return NULL;
+	}
+	info->type = type;
+	info->file_type = file_type;
+	self->next_type = (self->next_type+1) % TYPE_CACHE_SIZE;
+	return info;
+}
+
+
+/** The layout of a slice copy: a sequence of contiguous runs of bytes in the
+ * source, copied one after the other in the destination
+ */
+typedef struct copy_layout {
+
+	/** The number of dimensions iterated over to find the runs, the
+	 * innermost ones are merged in the runs
+	 */
+	unsigned rank;
+
+	/** The number of runs in each iterated dimension */
+	hsize_t count[MAX_RANK];
+
+	/** The distance in bytes between runs in each iterated dimension,
+	 * negative when the array is traversed backward */
+	ptrdiff_t stride[MAX_RANK];
+
+	/** The size in bytes of each run */
+	size_t run;
+
+	/** The size in bytes of each run once copied */
+	size_t dest_run;
+
+	/** The conversion applied to the runs, NULL to copy them as is */
+	const convert_t* convert;
+
+	/** The total number of runs */
+	size_t nb_runs;
+
+	/** Whether to copy with non-temporal stores */
+	int nt;
+
+} copy_layout_t;
+
+
+/** Computes the layout of a slice copy, merging the innermost dimensions
+ * into contiguous runs as long as they are contiguous in the array
+ * @param layout the layout to compute
+ * @param type_size the size in bytes of the elements in the array
+ * @param rank the number of dimensions of the array
+ * @param sizes the sizes of the array in each dimension
+ * @param strides the distance in bytes between elements in each dimension,
+ * NULL for a contiguous array
+ * @param lbounds the lower bounds of the block in each dimension
+ * @param ubounds the upper bounds of the block in each dimension
+ * @returns the offset in bytes of the block in the array
+ */
+static ptrdiff_t copy_layout_init( copy_layout_t* layout, size_t type_size, unsigned rank,
+		hsize_t* sizes, const ptrdiff_t* strides, hsize_t* lbounds, hsize_t* ubounds )
+{
+	ptrdiff_t stride[MAX_RANK];
+	ptrdiff_t offset = 0;
+	unsigned inner = rank;
+	int dim;
+
+	for ( dim = rank-1; dim>=0; --dim ) {
+		if ( strides ) {
+			stride[dim] = strides[dim];
+		} else {
+			stride[dim] = ( (unsigned)dim == rank-1 )? (ptrdiff_t)type_size
+					: stride[dim+1]*(ptrdiff_t)sizes[dim+1];
+		}
+		offset += (ptrdiff_t)lbounds[dim]*stride[dim];
+	}
+	/* the first dimension of the runs, the elements of a run follow each other
+	 * in the array */
+	layout->convert = NULL;
+	layout->run = type_size;
+	while ( inner > 0 && ( stride[inner-1] == (ptrdiff_t)layout->run
+			|| ubounds[inner-1]-lbounds[inner-1] == 1 ) ) {
+		layout->run *= ubounds[inner-1]-lbounds[inner-1];
+		--inner;
+	}
+	layout->rank = inner;
+	layout->nb_runs = 1;
+	for ( dim = 0; (unsigned)dim<inner; ++dim ) {
+		layout->count[dim] = ubounds[dim]-lbounds[dim];
+		layout->stride[dim] = stride[dim];
+		layout->nb_runs *= layout->count[dim];
+	}
+	if ( !layout->run ) layout->nb_runs = 0;
+	layout->dest_run = layout->run;
+	layout->nt = ( layout->nb_runs*layout->run >= NT_COPY_SIZE && layout->run >= NT_RUN_SIZE );
+	return offset;
+}
+
+
+/** Defines a kernel copying a row of runs of a fixed size, the compiler turns
+ * the memcpy into a few moves
+ */
+#define DEFINE_COPY_ROW(SIZE) \
+static void copy_row_##SIZE( char* dest, const char* src, ptrdiff_t stride, size_t nb ) \
+{ \
+	ptrdiff_t ii; \
+	for ( ii = 0; ii<(ptrdiff_t)nb; ++ii ) { \
+		__builtin_prefetch(src+(ii+PREFETCH_ROWS)*stride); \
+		memcpy(dest+ii*SIZE, src+ii*stride, SIZE); \
+	} \
+}
+DEFINE_COPY_ROW(4)
+DEFINE_COPY_ROW(8)
+DEFINE_COPY_ROW(16)
+DEFINE_COPY_ROW(24)
+DEFINE_COPY_ROW(32)
+DEFINE_COPY_ROW(48)
+DEFINE_COPY_ROW(64)
+
+
+/** Copies a row of runs, i.e. the runs along the innermost iterated dimension
+ * @param layout the layout of the copy
+ * @param dest where to copy the runs (contiguous)
+ * @param src the first run to copy
+ * @param stride the distance in bytes between the runs in src, possibly
+ * negative
+ * @param nb the number of runs to copy
+ */
+static void copy_row( const copy_layout_t* layout, char* dest, const char* src,
+		ptrdiff_t stride, size_t nb )
+{
+	ptrdiff_t ii;
+	if ( layout->convert ) {
+		const convert_t* convert = layout->convert;
+		size_t nb_elems = layout->run / convert->src_size;
+		for ( ii = 0; ii<(ptrdiff_t)nb; ++ii ) {
+			convert->kernel(dest+ii*layout->dest_run, src+ii*stride, nb_elems,
+					convert->scale, convert->offset);
+		}
+		return;
+	}
+	/* thin runs are dominated by the per-run overhead */
+	switch ( layout->run ) {
+	case 4: copy_row_4(dest, src, stride, nb); return;
+	case 8: copy_row_8(dest, src, stride, nb); return;
+	case 16: copy_row_16(dest, src, stride, nb); return;
+	case 24: copy_row_24(dest, src, stride, nb); return;
+	case 32: copy_row_32(dest, src, stride, nb); return;
+	case 48: copy_row_48(dest, src, stride, nb); return;
+	case 64: copy_row_64(dest, src, stride, nb); return;
+	}
+	for ( ii = 0; ii<(ptrdiff_t)nb; ++ii ) {
+		if ( layout->nt ) {
+			memcpy_nt(dest+ii*layout->run, src+ii*stride, layout->run);
+		} else {
+			memcpy(dest+ii*layout->run, src+ii*stride, layout->run);
+		}
+	}
+}
+
+
+/** Copies a range of the runs of a slice copy, iterating over the dimensions
+ * with the last one varying fastest
+ * @param layout the layout of the copy
+ * @param dest the destination of the whole copy (contiguous)
+ * @param src the first run of the whole copy
+ * @param first the index of the first run to copy
+ * @param last the index of the run after the last one to copy
+ */
+static void copy_runs( const copy_layout_t* layout, char* dest, const char* src,
+		size_t first, size_t last )
+{
+	hsize_t idx[MAX_RANK];
+	unsigned last_dim = layout->rank-1;
+	size_t run = first;
+	unsigned dim;
+
+	if ( first >= last ) return;
+	/* the position of the first run in each dimension */
+	for ( dim = layout->rank; dim>0; --dim ) {
+		idx[dim-1] = run % layout->count[dim-1];
+		run /= layout->count[dim-1];
+		src += (ptrdiff_t)idx[dim-1]*layout->stride[dim-1];
+	}
+	dest += first*layout->dest_run;
+	for ( run = first; run<last; ) {
+		/* copy up to the end of the innermost dimension in a tight loop */
+		size_t nb = layout->count[last_dim]-idx[last_dim];
+		if ( nb > last-run ) nb = last-run;
+		copy_row(layout, dest, src, layout->stride[last_dim], nb);
+		dest += nb*layout->dest_run;
+		src += (ptrdiff_t)nb*layout->stride[last_dim];
+		run += nb;
+		idx[last_dim] += nb;
+		/* move to the next row */
+		for ( dim = last_dim; dim>0 && idx[dim] == layout->count[dim]; --dim ) {
+			src -= (ptrdiff_t)idx[dim]*layout->stride[dim];
+			idx[dim] = 0;
+			++idx[dim-1];
+			src += layout->stride[dim-1];
+		}
+	}
+	if ( layout->nt ) nt_fence();
+}
+
+
+/** The description of a slice copy job */
+typedef struct slice_job {
+
+	/** the layout of the copy */
+	copy_layout_t* layout;
+
+	/** the destination of the copy */
+	char* dest;
+
+	/** the first run to copy */
+	const char* src;
+
+} slice_job_t;
+
+
+/** Executes a part of a slice copy job, each part is a contiguous range of
+ * the destination, as distributed by memset_par
+ * @param arg the slice_job_t description of the job
+ * @param part the part to execute
+ * @param nb_parts the number of parts
+ */
+static void slice_job( void* arg, size_t part, size_t nb_parts )
+{
+	slice_job_t* job = arg;
+	size_t nb_runs = job->layout->nb_runs;
+	copy_runs(job->layout, job->dest, job->src, nb_runs*part/nb_parts,
+			nb_runs*(part+1)/nb_parts);
+}
+
+
+/** The description of a contiguous conversion job */
+typedef struct convert_job {
+
+	/** the conversion */
+	const convert_t* convert;
+
+	/** the destination of the conversion */
+	char* dest;
+
+	/** the elements to convert */
+	const char* src;
+
+	/** the number of elements */
+	size_t nb;
+
+} convert_job_t;
+
+
+/** Executes a part of a contiguous conversion job
+ * @param arg the convert_job_t description of the job
+ * @param part the part to execute
+ * @param nb_parts the number of parts
+ */
+static void convert_job( void* arg, size_t part, size_t nb_parts )
+{
+	convert_job_t* job = arg;
+	const convert_t* convert = job->convert;
+	size_t begin = job->nb*part/nb_parts;
+	size_t end = job->nb*(part+1)/nb_parts;
+	convert->kernel(job->dest+begin*convert->dest_size, job->src+begin*convert->src_size,
+			end-begin, convert->scale, convert->offset);
+}
+
+
+/** Copies a slice of a nD array (in fact a block) from src to dest.
+ * @param dest the destination of the block (contiguous)
+ * @param src the source array where the block is
+ * @param type_size the size in bytes of the elements in the array
+ * @param rank the number of dimensions of the array
+ * @param sizes the sizes of the array in each dimension
+ * @param strides the distance in bytes between elements in each dimension,
+ * NULL for a contiguous array
+ * @param lbounds the lower bounds of the block in each dimension
+ * @param ubounds the upper bounds of the block in each dimension
+ * @param convert the conversion of the elements, NULL to copy them as is
+ * @param pool the threads to copy with, NULL to copy in the calling thread
+ * @return dest
+ */
+static void* slicecpy( void* dest, void* src, size_t type_size, unsigned rank, hsize_t* sizes,
+		const ptrdiff_t* strides, hsize_t* lbounds, hsize_t* ubounds, const convert_t* convert,
+		copy_pool_t* pool )
+{
+	slice_job_t job;
+	copy_layout_t layout;
+	char* first = ((char*)src) + copy_layout_init(&layout, type_size, rank, sizes, strides,
+			lbounds, ubounds);
+
+	if ( !layout.nb_runs ) return dest;
+	if ( convert ) {
+		layout.convert = convert;
+		layout.dest_run = layout.run / convert->src_size * convert->dest_size;
+		layout.nt = 0;
+	}
+	/* a contiguous block */
+	if ( layout.rank == 0 && convert ) {
+		convert_job_t cjob;
+		cjob.convert = convert;
+		cjob.dest = dest;
+		cjob.src = first;
+		cjob.nb = layout.run / convert->src_size;
+		pool_run(pool, convert_job, &cjob);
+		return dest;
+	}
+	if ( layout.rank == 0 ) {
+		if ( pool ) {
+			memcpy_par(pool, dest, first, layout.run);
+		} else if ( layout.nt ) {
+			memcpy_nt(dest, first, layout.run);
+			nt_fence();
+		} else {
+			memcpy(dest, first, layout.run);
+		}
+		return dest;
+	}
+	job.layout = &layout;
+	job.dest = dest;
+	job.src = first;
+	pool_run(layout.nb_runs > 1? pool : NULL, slice_job, &job);
+	return dest;
+}
+
+
+/** Primes of the fingerprints of the Data
+ */
+#define HASH_P1 UINT64_C(0x9E3779B185EBCA87)
+#define HASH_P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define HASH_P3 UINT64_C(0x165667B19E3779F9)
+
+
+/** Rotates a 64 bits word to the left
+ */
+#define HASH_ROTL(WORD, BITS) ( ((WORD) << (BITS)) | ((WORD) >> (64-(BITS))) )
+
+
+/** Mixes a 64 bits word in an accumulator of a fingerprint
+ * @param acc the accumulator
+ * @param word the word to mix in
+ * @returns the new accumulator
+ */
+inline static uint64_t hash_round( uint64_t acc, uint64_t word )
+{
+	acc += word*HASH_P2;
+	return HASH_ROTL(acc, 31)*HASH_P1;
+}
+
+
+/** Fingerprints a contiguous run of bytes, 32 bytes at a time in four
+ * independent lanes so that the multiplications of the lanes pipeline and
+ * vectorize
+ * @param src the bytes
+ * @param size the number of bytes
+ * @param seed the fingerprint to chain with
+ * @returns the fingerprint
+ */
+static uint64_t hash_bytes( const char* src, size_t size, uint64_t seed )
+{
+	uint64_t lanes[4];
+	uint64_t words[4];
+	uint64_t hash;
+	size_t ii = 0;
+	int lane;
+
+	lanes[0] = seed+HASH_P1+HASH_P2;
+	lanes[1] = seed+HASH_P2;
+	lanes[2] = seed;
+	lanes[3] = seed-HASH_P1;
+	for ( ; ii+32<=size; ii+=32 ) {
+		memcpy(words, src+ii, 32);
+		for ( lane = 0; lane<4; ++lane ) lanes[lane] = hash_round(lanes[lane], words[lane]);
+	}
+	hash = HASH_ROTL(lanes[0], 1) + HASH_ROTL(lanes[1], 7) + HASH_ROTL(lanes[2], 12)
+			+ HASH_ROTL(lanes[3], 18) + size;
+	/* then the tail, 8 bytes at a time, the last ones padded with zeroes */
+	for ( ; ii<size; ii+=8 ) {
+		uint64_t word = 0;
+		memcpy(&word, src+ii, ( size-ii < 8 )? size-ii : 8);
+		hash ^= hash_round(0, word);
+		hash = HASH_ROTL(hash, 27)*HASH_P1 + HASH_P3;
+	}
+	/* avalanche */
+	hash ^= hash >> 33;
+	hash *= HASH_P2;
+	hash ^= hash >> 29;
+	hash *= HASH_P3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+
+/** The description of a fingerprint job */
+typedef struct hash_job {
+
+	/** the layout of the part of the array to fingerprint */
+	copy_layout_t* layout;
+
+	/** the first run */
+	const char* src;
+
+	/** the fingerprint of each part */
+	uint64_t* hashes;
+
+} hash_job_t;
+
+
+/** Fingerprints a part of an array, each part chains the runs it covers,
+ * a contiguous block is split in pages
+ * @param arg the hash_job_t description of the job
+ * @param part the part to execute
+ * @param nb_parts the number of parts
+ */
+static void hash_job( void* arg, size_t part, size_t nb_parts )
+{
+	hash_job_t* job = arg;
+	const copy_layout_t* layout = job->layout;
+	hsize_t idx[MAX_RANK];
+	const char* src = job->src;
+	uint64_t hash = part;
+	size_t first, last, run;
+	unsigned dim;
+
+	if ( layout->rank == 0 ) {
+		split_pages(layout->run, part, nb_parts, &first, &last);
+		job->hashes[part] = hash_bytes(src+first, last-first, hash);
+		return;
+	}
+	first = layout->nb_runs*part/nb_parts;
+	last = layout->nb_runs*(part+1)/nb_parts;
+	/* the position of the first run in each dimension, as in copy_runs */
+	run = first;
+	for ( dim = layout->rank; dim>0; --dim ) {
+		idx[dim-1] = run % layout->count[dim-1];
+		run /= layout->count[dim-1];
+		src += (ptrdiff_t)idx[dim-1]*layout->stride[dim-1];
+	}
+	for ( run = first; run<last; ++run ) {
+		hash = hash_bytes(src, layout->run, hash);
+		for ( dim = layout->rank; dim>0; --dim ) {
+			src += layout->stride[dim-1];
+			if ( ++idx[dim-1] < layout->count[dim-1] ) break;
+			src -= (ptrdiff_t)idx[dim-1]*layout->stride[dim-1];
+			idx[dim-1] = 0;
+		}
+	}
+	job->hashes[part] = hash;
+}
+
+
+/** Fingerprints the part of the user array of a Data to write, the
+ * fingerprint depends on the number of threads in the pool
+ * @param data the Data
+ * @param pool the threads to fingerprint with, NULL to do it in the calling
+ * thread
+ * @returns the fingerprint
+ */
+static uint64_t data_hash( data_id_t* data, copy_pool_t* pool )
+{
+	size_t src_size = data->convert.kernel? data->convert.src_size : data->type_size;
+	size_t nb_parts = ( pool && pool->nb_threads )? pool->nb_threads+1 : 1;
+	copy_layout_t layout;
+	hash_job_t job;
+	uint64_t hash;
+
+	job.layout = &layout;
+	job.src = ((char*)data->buf) + copy_layout_init(&layout, src_size, data->rank,
+			data->dims, data->rank? data->strides : NULL, data->lbounds, data->ubounds);
+	job.hashes = malloc(nb_parts*sizeof(uint64_t));
+	pool_run(nb_parts > 1? pool : NULL, hash_job, &job);
+	hash = hash_bytes((const char*)job.hashes, nb_parts*sizeof(uint64_t), layout.nb_runs);
+	free(job.hashes);
+	return hash;
+}
+
+
+/** Copies a Data in its place in the staging buffer, in slabs of rows that
+ * the writer threads can write as soon as they are staged
+ * @param self a pointer to the instance state
+ * @param list the command list of the Data
+ * @param data the Data to copy
+ * @param pool the threads to copy with, NULL to copy in the calling thread
+ * @pre the instance mutex is not held
+ */
+static void data_stage( ah5_t self, cmd_list_t* list, data_id_t* data, copy_pool_t* pool )
+{
+	hsize_t lbounds[MAX_RANK];
+	hsize_t ubounds[MAX_RANK];
+	const convert_t* convert = data->convert.kernel? &(data->convert) : NULL;
+	/* the user array holds elements of the source type when converted */
+	size_t src_size = convert? convert->src_size : data->type_size;
+	size_t row_size = data->type_size;
+	hsize_t nb_rows = 1;
+	hsize_t slab_rows;
+	unsigned dim;
+	int64_t start_time = clockget();
+
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		lbounds[dim] = data->lbounds[dim];
+		ubounds[dim] = data->ubounds[dim];
+		if ( dim ) row_size *= ubounds[dim]-lbounds[dim];
+	}
+	if ( data->rank ) nb_rows = ubounds[0]-lbounds[0];
+	slab_rows = row_size? WRITE_BLOCK_SIZE / row_size : nb_rows;
+	if ( slab_rows < 1 ) slab_rows = 1;
+	if ( !data->rank ) {
+		slicecpy(data->staging, data->buf, src_size, 0, NULL, NULL, NULL, NULL, convert, pool);
+	}
+	while ( data->rank && data->staged_rows < nb_rows ) {
+		hsize_t rows = nb_rows-data->staged_rows;
+		if ( rows > slab_rows ) rows = slab_rows;
+		lbounds[0] = data->lbounds[0]+data->staged_rows;
+		ubounds[0] = lbounds[0]+rows;
+		slicecpy(((char*)data->staging)+data->staged_rows*row_size, data->buf,
+				src_size, data->rank, data->dims, data->strides, lbounds, ubounds, convert, pool);
+		if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+		data->staged_rows += rows;
+		/* let the writer threads write the rows staged so far */
+		if ( pthread_cond_broadcast(&(self->cond)) ) SIGNAL_ERROR;
+		if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+	}
+	LOG_DEBUG("copy duration: %" PRId64 "us", clockget()-start_time);
+	stats_record(self, list, AH5_PHASE_COPY, start_time);
+	STATS_COUNT(self, list, bytes_copied, nb_rows*row_size);
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	data->staged = 1;
+	data->released = 1;
+	/* the writers may wait for this Data, the user for its array */
+	if ( pthread_cond_broadcast(&(self->cond)) ) SIGNAL_ERROR;
+	if ( pthread_cond_broadcast(&(self->free_cond)) ) SIGNAL_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+}
+
+
+/** Looks for the oldest sealed command list with Data left to copy
+ * @param self a pointer to the instance state
+ * @returns the command list with Data to copy or NULL if there is none
+ * @pre the instance mutex is held
+ */
+static cmd_list_t* find_pending_copy( ah5_t self )
+{
+	cmd_list_t* oldest = NULL;
+	size_t ii;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		cmd_list_t* list = &(self->lists[ii]);
+		if ( list->state != LIST_READY && list->state != LIST_WRITING ) continue;
+		if ( list->next_copy == list->data_size ) continue;
+		if ( !oldest || list->serial < oldest->serial ) oldest = list;
+	}
+	return oldest;
+}
+
+
+/** The function executed by the copy thread, it copies the Data of sealed
+ * command lists in the staging buffers, oldest first and in order
+ * @param self_void a pointer to the instance state as a void*
+ * @returns NULL
+ */
+static void* copier_thread_loop( void* self_void )
+{
+	ah5_t self = self_void;
+	if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+	LOG_STATUS("async HDF5 copy thread started");
+	for (;;) {
+		cmd_list_t* list = find_pending_copy(self);
+		if ( list ) {
+			data_id_t* data = &(list->data[list->next_copy++]);
+			copy_pool_t* pool = self->parallel_copy? &(self->pool) : NULL;
+			if ( !data->staged ) {
+				if ( pthread_mutex_unlock(&(self->mutex)) ) SIGNAL_ERROR;
+				data_stage(self, list, data, pool);
+				if ( pthread_mutex_lock(&(self->mutex)) ) SIGNAL_ERROR;
+			}
+			continue;
+		}
+
+		/* if there is nothing left to copy and the command is to stop ... stop */
+		if ( self->thread_cmd == CMD_TERMINATE ) {
+			pthread_mutex_unlock(&(self->mutex));
+			return NULL;
+		}
+
+		/* otherwise ... wait for something to do */
+		if ( pthread_cond_wait(&(self->copy_cond), &(self->mutex)) ) SIGNAL_ERROR;
+	}
+}
+
+
+/** Releases the memory held by a command list slot
+ * @param list the command list slot
+ */
+static void list_clear( cmd_list_t* list )
+{
+	name_block_t* block;
+	/* the name blocks are kept for the next command list */
+	for ( block = list->names; block; block = block->next ) {
+		block->used = 0;
+	}
+	list->name_block = list->names;
+	/* reset the number of records */
+	list->data_size = 0;
+	list->plan = NULL;
+}
+
+
+/** Frees the memory held by a command list slot
+ * @param self a pointer to the instance state
+ * @param list the command list slot
+ */
+static void list_free( ah5_t self, cmd_list_t* list )
+{
+	list_clear(list);
+	while ( list->names ) {
+		name_block_t* next = list->names->next;
+		free(list->names);
+		list->names = next;
+	}
+	free(list->data);
+	free(list->blocks);
+	arena_release(self, &(list->data_buffer));
+	free(list->file_name);
+}
+
+
+/** Stores the name of a Data in the name blocks of a command list
+ * @param list the command list
+ * @param name the name to store
+ * @returns the stored name, valid until the list is cleared
+ */
+static char* list_name( cmd_list_t* list, const char* name )
+{
+	size_t size = strlen(name)+1;
+	char* result;
+	while ( list->name_block && list->name_block->used+size > list->name_block->capacity ) {
+		list->name_block = list->name_block->next;
+	}
+	if ( !list->name_block ) {
+		name_block_t* block;
+		size_t capacity = ( size > NAME_BLOCK_SIZE )? size : NAME_BLOCK_SIZE;
+		block = malloc(sizeof(name_block_t)+capacity);
+		block->capacity = capacity;
+		block->used = 0;
+		/* new blocks go first, the full ones are reused after list_clear */
+		block->next = list->names;
+		list->names = block;
+		list->name_block = block;
+	}
+	result = list->name_block->names + list->name_block->used;
+	memcpy(result, name, size);
+	list->name_block->used += size;
+	return result;
+}
+
+
+/** Makes room for a number of commands in a command list, the data array
+ * grows geometrically and is kept for the next command lists
+ * @param list the command list
+ * @param size the number of commands
+ */
+static void list_reserve( cmd_list_t* list, size_t size )
+{
+	size_t capacity = list->data_capacity;
+	if ( size <= capacity ) return;
+	if ( capacity < 16 ) capacity = 16;
+	while ( capacity < size ) capacity *= 2;
+	/* a writer thread may be reading the submitted commands */
+	list_lock_data(list);
+	list->data = realloc(list->data, capacity*sizeof(data_id_t));
+	list_unlock_data(list);
+	list->data_capacity = capacity;
+}
+
+
+/** Closes the file and datasets created before a command list was sealed
+ * when the list is dropped
+ * @param self a pointer to the instance state
+ * @param list the command list
+ */
+static void list_abort( ah5_t self, cmd_list_t* list )
+{
+	size_t did;
+	if ( !list->early ) return;
+	if ( h5_lock() ) SIGNAL_ERROR;
+	for ( did = 0; did<list->created; ++did ) {
+		if ( list->data[did].written || list->data[did].dropped ) continue;
+		if ( H5Dclose(list->data[did].dset_id) ) SIGNAL_ERROR;
+	}
+	if ( H5Fclose(list->file_id) ) SIGNAL_ERROR;
+	if ( h5_unlock() ) SIGNAL_ERROR;
+	list->early = 0;
+}
+
+
+/** Drops a command list being filled so that its slot can be reused
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @param remove whether to remove the file created before the list was sealed
+ * @returns 0 on success, non-null on error
+ */
+static int list_drop( ah5_t self, cmd_list_t* list, int remove )
+{
+	int early;
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	while ( list->early_busy ) {
+		if ( pthread_cond_wait(&(self->cond), &(self->mutex)) ) RETURN_ERROR;
+	}
+	list->state = LIST_FREE;
+	if ( pthread_cond_broadcast(&(self->free_cond)) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	early = list->early;
+	list_abort(self, list);
+	if ( list->local_name ) {
+		/* the drain threads wait for every file of the burst buffer in turn */
+		if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+		burst_submit(self, list, remove);
+		if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+		return 0;
+	}
+	/* files built in memory do not exist yet */
+	if ( remove && early && unlink(list->file_name) && errno != ENOENT ) {
+		LOG_WARNING("unable to remove the dropped file %s", list->file_name);
+	}
+	return 0;
+}
+
+
+/** Computes the size of the staging buffer of a command list
+ * @param list the command list
+ * @returns the total size of the Data to copy
+ */
+static size_t list_staging_size( cmd_list_t* list )
+{
+	size_t buf_size = 0;
+	size_t ii;
+	/* the plan knows it */
+	if ( list->plan ) return list->plan->buf_size;
+	for ( ii = 0; ii<list->data_size; ++ii ) {
+		size_t data_size = list->data[ii].type_size;
+		unsigned dim;
+		if ( list->data[ii].nocopy || list->data[ii].dropped || list->data[ii].linked ) continue;
+		for ( dim = 0; dim < list->data[ii].rank; ++dim ) {
+			/* ubounds is just after the data, so the difference with lbound is the size */
+			data_size *= list->data[ii].ubounds[dim]-list->data[ii].lbounds[dim];
+		}
+		buf_size += data_size;
+	}
+	return buf_size;
+}
+
+
+/** Waits for the staging memory of all instances using the shared scheduler
+ * to leave room for a sealed command list, then accounts for it
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @returns 0 on success, non-null on error
+ */
+static int sched_admit( ah5_t self, cmd_list_t* list )
+{
+	size_t bytes;
+	list->sched_bytes = 0;
+	if ( self->sched_priority < 0 ) return 0;
+	bytes = list_staging_size(list);
+	if ( pthread_mutex_lock(&(scheduler.mutex)) ) RETURN_ERROR;
+	/* a list larger than the limit is admitted alone */
+	while ( scheduler.mem_limit && scheduler.mem_inflight
+			&& scheduler.mem_inflight+bytes > scheduler.mem_limit ) {
+		LOG_STATUS("shared memory limit reached, waiting for the writer threads");
+		if ( pthread_cond_wait(&(scheduler.cond), &(scheduler.mutex)) ) RETURN_ERROR;
+	}
+	scheduler.mem_inflight += bytes;
+	list->sched_bytes = bytes;
+	if ( pthread_mutex_unlock(&(scheduler.mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+/** Keeps the writer threads from creating the datasets of a command list
+ * being filled, so that the user thread can modify its commands
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @returns 0 on success, -1 on error
+ */
+static int list_claim( ah5_t self, cmd_list_t* list )
+{
+	if ( pthread_mutex_lock(&(self->mutex)) ) return -1;
+	while ( list->early_busy ) {
+		if ( pthread_cond_wait(&(self->cond), &(self->mutex)) ) {
+			pthread_mutex_unlock(&(self->mutex));
+			return -1;
+		}
+	}
+	list->early_busy = 1;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) return -1;
+	return 0;
+}
+
+
+/** Lets the writer threads create the datasets of a command list again
+ * @param self a pointer to the instance state
+ * @param list the command list, claimed by list_claim
+ * @returns 0 on success, -1 on error
+ */
+static int list_unclaim( ah5_t self, cmd_list_t* list )
+{
+	if ( pthread_mutex_lock(&(self->mutex)) ) return -1;
+	list->early_busy = 0;
+	if ( pthread_cond_broadcast(&(self->cond)) ) return -1;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) return -1;
+	return 0;
+}
+
+
+/** Drops the non-essential Data of a command list being filled that would be
+ * copied, removes their datasets if they have already been created
+ * @param self a pointer to the instance state
+ * @param list the command list
+ * @returns the number of dropped Data, -1 on error
+ */
+static int list_degrade( ah5_t self, cmd_list_t* list )
+{
+	int nb_dropped = 0;
+	int h5_locked = 0;
+	int errno_save;
+	size_t did;
+	/* keep the writer threads away from the datasets of the list */
+	if ( list_claim(self, list) ) return -1;
+	for ( did = 0; did<list->data_size; ++did ) {
+		data_id_t* data = &(list->data[did]);
+		if ( data->essential || data->nocopy || data->linked ) continue;
+		LOG_DEBUG("dropping non-essential data %s", data->name);
+		data->dropped = 1;
+		++nb_dropped;
+		if ( did >= list->created ) continue;
+		if ( h5_lock() ) goto err;
+		h5_locked = 1;
+		if ( H5Dclose(data->dset_id) ) goto err;
+		if ( H5Ldelete(list->file_id, data->name, H5P_DEFAULT) ) goto err;
+		h5_locked = 0;
+		if ( h5_unlock() ) goto err;
+	}
+	/* the offsets of the plan include the dropped Data */
+	if ( nb_dropped ) list->plan = NULL;
+	if ( list_unclaim(self, list) ) return -1;
+	return nb_dropped;
+
+err:
+	/* let the writer threads go on with the list whatever happened */
+	errno_save = errno;
+	if ( h5_locked ) h5_unlock();
+	list_unclaim(self, list);
+	errno = errno_save;
+	return -1;
+}
+
+
+/** Finds the fingerprint of the last copy of a variable written in delta
+ * mode
+ * @param self a pointer to the instance state
+ * @param name the name of the variable
+ * @returns the fingerprint, NULL if the variable has not been written yet
+ */
+static delta_t* delta_find( ah5_t self, const char* name )
+{
+	delta_t* delta = self->deltas[hash_bytes(name, strlen(name), 0) % DELTA_BUCKETS];
+	while ( delta && strcmp(delta->name, name) ) delta = delta->next;
+	return delta;
+}
+
+
+/** Checks whether a Data is the same as the last copy of its variable
+ * @param delta the fingerprint of the last copy
+ * @param data the fingerprinted Data
+ * @returns 1 if it is, 0 if not, -1 on error
+ */
+static int delta_matches( delta_t* delta, data_id_t* data )
+{
+	unsigned dim;
+	int equal;
+	if ( delta->hash != data->hash || delta->rank != data->rank ) return 0;
+	if ( delta->scale != data->convert.scale || delta->offset != data->convert.offset ) return 0;
+	for ( dim = 0; dim<data->rank; ++dim ) {
+		if ( delta->count[dim] != data->ubounds[dim]-data->lbounds[dim]
+				|| delta->global_dims[dim] != data->global_dims[dim]
+				|| delta->position[dim] != data->offset[dim] ) return 0;
+	}
+	if ( h5_lock() ) return -1;
+	equal = H5Tequal(delta->type, data->type);
+	if ( h5_unlock() ) return -1;
+	return equal > 0;
+}
+
+
+/** Checks whether a file has been overwritten while linked into
+ * @param self a pointer to the instance state
+ * @param file_name the name of the file
+ * @returns 1 if it has, 0 if not
+ */
+static int delta_reused( ah5_t self, const char* file_name )
+{
+	delta_link_t* reused;
+	for ( reused = self->delta_reused; reused; reused = reused->next ) {
+		if ( !strcmp(reused->target, file_name) ) return 1;
+	}
+	return 0;
+}
+
+
+/** Frees a list of external links
+ * @param link the first link of the list
+ */
+static void delta_links_free( delta_link_t* link )
+{
+	while ( link ) {
+		delta_link_t* next = link->next;
+		free(link->file_name);
+		free(link->name);
+		free(link->target);
+		free(link);
+		link = next;
+	}
+}
+
+
+/** Fingerprints the Data of a command list written in delta mode, those
+ * unchanged since their last copy are marked to be linked to it
+ * @param self a pointer to the instance state
+ * @param list the command list being finished
+ * @returns 0 on success, non-null on error
+ */
+static int delta_check( ah5_t self, cmd_list_t* list )
+{
+	copy_pool_t* pool = self->parallel_copy? &(self->pool) : NULL;
+	const char* dir_end = strrchr(list->file_name, '/');
+	size_t dir_len = dir_end? (size_t)(dir_end-list->file_name)+1 : 0;
+	size_t did;
+	for ( did = 0; did<list->data_size; ++did ) {
+		data_id_t* data = &(list->data[did]);
+		delta_t* delta;
+		const char* base;
+		int matches;
+		if ( !data->delta ) continue;
+		/* a series has a single file and the processes writing collectively
+		 * may not agree on the fingerprints */
+		if ( list->append || self->collective ) {
+			data->delta = 0;
+			continue;
+		}
+		data->hash = data_hash(data, pool);
+		delta = delta_find(self, data->name);
+		/* the file holding the last copy is about to be overwritten, or may
+		 * be overwritten again */
+		if ( !delta || !strcmp(delta->file_name, list->file_name)
+				|| delta_reused(self, delta->file_name) ) continue;
+		matches = delta_matches(delta, data);
+		if ( matches < 0 ) RETURN_ERROR;
+		if ( !matches ) continue;
+		LOG_DEBUG("data %s unchanged since written in %s", data->name, delta->file_name);
+		/* HDF5 looks for the target of an external link in the directory of
+		 * the linking file first */
+		base = strrchr(delta->file_name, '/');
+		base = base? base+1 : delta->file_name;
+		if ( (size_t)(base-delta->file_name) != dir_len
+				|| strncmp(delta->file_name, list->file_name, dir_len) ) {
+			base = delta->file_name;
+		}
+		data->link_target = list_name(list, base);
+		data->linked = 1;
+	}
+	return 0;
+}
+
+
+/** Records the fingerprints of the Data of a command list written in delta
+ * mode that are actually written
+ * @param self a pointer to the instance state
+ * @param list the command list being finished, not skipped
+ * @returns 0 on success, non-null on error
+ */
+static int delta_commit( ah5_t self, cmd_list_t* list )
+{
+	size_t did;
+	for ( did = 0; did<list->data_size; ++did ) {
+		data_id_t* data = &(list->data[did]);
+		delta_t* delta;
+		unsigned dim;
+		if ( data->linked ) {
+			size_t data_size = data->type_size;
+			delta_link_t* link = malloc(sizeof(delta_link_t));
+			for ( dim = 0; dim<data->rank; ++dim ) {
+				data_size *= data->ubounds[dim]-data->lbounds[dim];
+			}
+			STATS_COUNT(self, list, bytes_linked, data_size);
+			/* remember the link to keep it valid when its target is overwritten */
+			delta = delta_find(self, data->name);
+			link->file_name = malloc(strlen(list->file_name)+1);
+			strcpy(link->file_name, list->file_name);
+			link->name = malloc(strlen(data->name)+1);
+			strcpy(link->name, data->name);
+			link->target = malloc(strlen(delta->file_name)+1);
+			strcpy(link->target, delta->file_name);
+			link->next = self->delta_links;
+			self->delta_links = link;
+			continue;
+		}
+		if ( !data->delta || data->dropped ) continue;
+		delta = delta_find(self, data->name);
+		if ( !delta ) {
+			size_t bucket = hash_bytes(data->name, strlen(data->name), 0) % DELTA_BUCKETS;
+			delta = malloc(sizeof(delta_t));
+			delta->name = malloc(strlen(data->name)+1);
+			strcpy(delta->name, data->name);
+			delta->next = self->deltas[bucket];
+			self->deltas[bucket] = delta;
+		} else {
+			free(delta->file_name);
+			if ( h5_lock() ) RETURN_ERROR;
+			if ( H5Tclose(delta->type) ) RETURN_ERROR;
+			if ( h5_unlock() ) RETURN_ERROR;
+		}
+		delta->hash = data->hash;
+		if ( h5_lock() ) RETURN_ERROR;
+		/* the user may close the type afterwards */
+		delta->type = H5Tcopy(data->type);
+		if ( h5_unlock() ) RETURN_ERROR;
+		delta->scale = data->convert.scale;
+		delta->offset = data->convert.offset;
+		delta->rank = data->rank;
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			delta->count[dim] = data->ubounds[dim]-data->lbounds[dim];
+			delta->global_dims[dim] = data->global_dims[dim];
+			delta->position[dim] = data->offset[dim];
+		}
+		delta->file_name = malloc(strlen(list->file_name)+1);
+		strcpy(delta->file_name, list->file_name);
+	}
+	return 0;
+}
+
+
+/** Releases the staging buffers of the free slots other than the one being
+ * filled
+ * @param self a pointer to the instance state
+ * @pre the instance mutex is held
+ */
+static void arenas_trim( ah5_t self )
+{
+	size_t ii;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		if ( ii == self->fill_idx || self->lists[ii].state != LIST_FREE ) continue;
+		arena_release(self, &(self->lists[ii].data_buffer));
+	}
+}
+
+
+/** Makes the staging buffer of a command list large enough, applying the
+ * backpressure policy when this would exceed the memory limit
+ * @param self a pointer to the instance state
+ * @param list the command list being finished
+ * @param outcome the ah5_backpressure_t policy that has been applied,
+ * AH5_BACKPRESSURE_BLOCK when the list has not been degraded, skipped or
+ * spilled
+ * @returns 0 on success, non-null on error
+ */
+static int staging_reserve( ah5_t self, cmd_list_t* list, ah5_backpressure_t* outcome )
+{
+	size_t buf_size = list_staging_size(list);
+	int64_t start_time;
+	int policy;
+	int fits;
+
+	*outcome = AH5_BACKPRESSURE_BLOCK;
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	/* the Data of a loading list can be neither skipped nor dropped */
+	policy = list->load? AH5_BACKPRESSURE_BLOCK : self->backpressure;
+	fits = arena_fits(self, &(list->data_buffer), buf_size);
+	if ( !fits ) {
+		/* the memory kept for the next command lists goes first */
+		arenas_trim(self);
+		fits = arena_fits(self, &(list->data_buffer), buf_size);
+	}
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	if ( fits ) return arena_reserve(self, &(list->data_buffer), buf_size, 0);
+
+	if ( policy == AH5_BACKPRESSURE_SPILL ) {
+		LOG_STATUS("memory limit reached, staging the command list in a scratch file");
+		*outcome = AH5_BACKPRESSURE_SPILL;
+		return arena_reserve(self, &(list->data_buffer), buf_size, 1);
+	}
+	if ( policy == AH5_BACKPRESSURE_SKIP ) {
+		*outcome = AH5_BACKPRESSURE_SKIP;
+		return 0;
+	}
+	if ( policy == AH5_BACKPRESSURE_DEGRADE ) {
+		int nb_dropped = list_degrade(self, list);
+		if ( nb_dropped < 0 ) RETURN_ERROR;
+		if ( nb_dropped ) {
+			*outcome = AH5_BACKPRESSURE_DEGRADE;
+			buf_size = list_staging_size(list);
+		}
+		/* then wait for the rest as with the blocking policy */
+	}
+
+	start_time = clockget();
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	for (;;) {
+		size_t ii;
+		int in_flight = 0;
+		arenas_trim(self);
+		if ( arena_fits(self, &(list->data_buffer), buf_size) ) break;
+		for ( ii = 0; ii<self->nb_lists; ++ii ) {
+			if ( self->lists[ii].state == LIST_READY || self->lists[ii].state == LIST_WRITING ) in_flight = 1;
+		}
+		if ( !in_flight ) {
+			if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+			LOG_ERROR("staging %lu bytes would exceed the memory limit of %lu bytes",
+					(unsigned long)buf_size, (unsigned long)self->mem_limit);
+			errno = ENOMEM;
+			return ENOMEM;
+		}
+		LOG_STATUS("memory limit reached, waiting for writer thread");
+		if ( pthread_cond_wait(&(self->free_cond), &(self->mutex)) ) RETURN_ERROR;
+	}
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	stats_record(self, list, AH5_PHASE_WAIT, start_time);
+	return arena_reserve(self, &(list->data_buffer), buf_size, 0);
+}
+
+
+/** Waits for the writer thread to execute all sealed command lists
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ * @post the instance mutex is held
+ */
+inline static int writer_thread_drain( ah5_t self )
+{
+	size_t ii;
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		while ( self->lists[ii].state == LIST_READY || self->lists[ii].state == LIST_WRITING ) {
+			LOG_STATUS("waiting for writer thread");
+			if ( pthread_cond_wait(&(self->free_cond), &(self->mutex)) ) RETURN_ERROR;
+		}
+	}
+	return 0;
+}
+
+
+/** Checks whether the memory associated to a token has been released
+ * @param self a pointer to the instance state
+ * @param token the token to check
+ * @returns 1 if released, 0 if not, -1 if the token is invalid
+ * @pre the instance mutex is held
+ */
+static int token_released( ah5_t self, ah5_token_t token )
+{
+	uint64_t serial = ((uint64_t)token) >> TOKEN_VAR_BITS;
+	size_t var = ((uint64_t)token) & ((UINT64_C(1)<<TOKEN_VAR_BITS)-1);
+	size_t ii;
+	if ( token <= 0 || serial >= self->next_serial ) return -1;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		cmd_list_t* list = &(self->lists[ii]);
+		if ( list->serial != serial ) continue;
+		switch ( list->state ) {
+		case LIST_FREE:
+			return 1;
+		case LIST_FILLING:
+			return 0;
+		case LIST_LOADED:
+			return 1;
+		default:
+			if ( var == 0 ) return 0;
+			if ( var > list->data_size ) return -1;
+			return list->data[var-1].released;
+		}
+	}
+	/* the slot has been reused since, the list was fully written */
+	return 1;
+}
+
+
+/** Writes the cumulative statistics in the statistics file
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ */
+static int stats_dump( ah5_t self )
+{
+	ah5_stats_t stats;
+	FILE* file = fopen(self->stats_file, "w");
+	int phase, bucket;
+	if ( !file ) RETURN_ERROR;
+	stats_lock(self);
+	stats = self->stats;
+	stats_unlock(self);
+	stats_derive(&stats);
+	if ( self->stats_format == AH5_STATS_CSV ) {
+		fprintf(file, "metric,value\n");
+		fprintf(file, "lists,%" PRIu64 "\n", stats.lists);
+		fprintf(file, "lists_skipped,%" PRIu64 "\n", stats.lists_skipped);
+		fprintf(file, "lists_degraded,%" PRIu64 "\n", stats.lists_degraded);
+		fprintf(file, "lists_spilled,%" PRIu64 "\n", stats.lists_spilled);
+		fprintf(file, "bytes_copied,%" PRIu64 "\n", stats.bytes_copied);
+		fprintf(file, "bytes_written,%" PRIu64 "\n", stats.bytes_written);
+		fprintf(file, "bytes_linked,%" PRIu64 "\n", stats.bytes_linked);
+		fprintf(file, "blocked_us,%" PRIu64 "\n", stats.blocked_us);
+		fprintf(file, "io_us,%" PRIu64 "\n", stats.io_us);
+		fprintf(file, "copy_bandwidth,%g\n", stats.copy_bandwidth);
+		fprintf(file, "write_bandwidth,%g\n", stats.write_bandwidth);
+		fprintf(file, "overlap,%g\n", stats.overlap);
+		for ( phase = 0; phase<AH5_NB_PHASES; ++phase ) {
+			ah5_phase_stats_t* phase_stats = &(stats.phases[phase]);
+			fprintf(file, "%s.count,%" PRIu64 "\n", PHASE_NAMES[phase], phase_stats->count);
+			fprintf(file, "%s.total_us,%" PRIu64 "\n", PHASE_NAMES[phase], phase_stats->total_us);
+			fprintf(file, "%s.max_us,%" PRIu64 "\n", PHASE_NAMES[phase], phase_stats->max_us);
+			for ( bucket = 0; bucket<AH5_HIST_BUCKETS; ++bucket ) {
+				fprintf(file, "%s.histogram.%d,%" PRIu64 "\n", PHASE_NAMES[phase], bucket,
+						phase_stats->histogram[bucket]);
+			}
+		}
+	} else {
+		fprintf(file, "{\n");
+		fprintf(file, "  \"lists\": %" PRIu64 ",\n", stats.lists);
+		fprintf(file, "  \"lists_skipped\": %" PRIu64 ",\n", stats.lists_skipped);
+		fprintf(file, "  \"lists_degraded\": %" PRIu64 ",\n", stats.lists_degraded);
+		fprintf(file, "  \"lists_spilled\": %" PRIu64 ",\n", stats.lists_spilled);
+		fprintf(file, "  \"bytes_copied\": %" PRIu64 ",\n", stats.bytes_copied);
+		fprintf(file, "  \"bytes_written\": %" PRIu64 ",\n", stats.bytes_written);
+		fprintf(file, "  \"bytes_linked\": %" PRIu64 ",\n", stats.bytes_linked);
+		fprintf(file, "  \"blocked_us\": %" PRIu64 ",\n", stats.blocked_us);
+		fprintf(file, "  \"io_us\": %" PRIu64 ",\n", stats.io_us);
+		fprintf(file, "  \"copy_bandwidth\": %g,\n", stats.copy_bandwidth);
+		fprintf(file, "  \"write_bandwidth\": %g,\n", stats.write_bandwidth);
+		fprintf(file, "  \"overlap\": %g,\n", stats.overlap);
+		fprintf(file, "  \"phases\": {\n");
+		for ( phase = 0; phase<AH5_NB_PHASES; ++phase ) {
+			ah5_phase_stats_t* phase_stats = &(stats.phases[phase]);
+			fprintf(file, "    \"%s\": {\"count\": %" PRIu64 ", \"total_us\": %" PRIu64
+					", \"max_us\": %" PRIu64 ", \"histogram\": [", PHASE_NAMES[phase],
+					phase_stats->count, phase_stats->total_us, phase_stats->max_us);
+			for ( bucket = 0; bucket<AH5_HIST_BUCKETS; ++bucket ) {
+				fprintf(file, "%s%" PRIu64, bucket? ", " : "", phase_stats->histogram[bucket]);
+			}
+			fprintf(file, "]}%s\n", ( phase+1<AH5_NB_PHASES )? "," : "");
+		}
+		fprintf(file, "  }\n");
+		fprintf(file, "}\n");
+	}
+	if ( fclose(file) ) RETURN_ERROR;
+	return 0;
+}
+
+
+/** Creates the file access property list from the file settings, files
+ * built in memory take precedence over the io_uring file driver
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ * @pre the writer threads are idle
+ */
+static int file_plist_update( ah5_t self )
+{
+	if ( h5_lock() ) RETURN_ERROR;
+	if ( self->file_plist != H5P_DEFAULT && H5Pclose(self->file_plist) ) RETURN_ERROR;
+	self->file_plist = H5P_DEFAULT;
+	if ( self->image_block ) {
+		/* the image is kept in memory only, it grows by blocks */
+		self->file_plist = H5Pcreate(H5P_FILE_ACCESS);
+		if ( H5Pset_fapl_core(self->file_plist, self->image_block, 0) ) RETURN_ERROR;
+	}
+#ifdef AH5_HAVE_URING
+	else if ( self->uring_depth ) {
+		uring_fapl_t fa;
+		if ( uring_driver < 0 ) uring_driver = H5FDregister(&URING_CLASS);
+		if ( uring_driver < 0 ) RETURN_ERROR;
+		fa.depth = self->uring_depth;
+		fa.buffer_size = self->uring_buffer_size? self->uring_buffer_size : URING_BUFFER_SIZE;
+		self->file_plist = H5Pcreate(H5P_FILE_ACCESS);
+		if ( H5Pset_driver(self->file_plist, uring_driver, &fa) ) RETURN_ERROR;
+	}
+#endif
+	if ( h5_unlock() ) RETURN_ERROR;
+	return 0;
+}
+
+
+/** Starts the writer threads and the copy thread
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ */
+static int writer_threads_start( ah5_t self )
+{
+	pthread_attr_t attr;
+	int ii;
+	self->thread_cmd = CMD_RUN;
+	self->threads = malloc(self->nb_writers*sizeof(pthread_t));
+	if ( pthread_attr_init(&attr) ) RETURN_ERROR;
+	if ( self->bind_writers && pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t),
+			&(self->writer_cpus)) ) RETURN_ERROR;
+	for ( ii = 0; ii<self->nb_writers; ++ii ) {
+		if ( pthread_create(&(self->threads[ii]), &attr, writer_thread_loop, self) ) RETURN_ERROR;
+	}
+	if ( pthread_create(&(self->copy_thread), &attr, copier_thread_loop, self) ) RETURN_ERROR;
+	if ( pthread_attr_destroy(&attr) ) RETURN_ERROR;
+	return 0;
+}
+
+
+/** Stops the writer threads and the copy thread once they have written all
+ * sealed command lists
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ * @pre the instance mutex is held
+ * @post the instance mutex is released
+ */
+static int writer_threads_stop( ah5_t self )
+{
+	int ii;
+	/* tell the writer threads to terminate */
+	self->thread_cmd = CMD_TERMINATE;
+	if ( pthread_cond_broadcast(&(self->cond)) ) RETURN_ERROR;
+	if ( pthread_cond_signal(&(self->copy_cond)) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	/* wait for the writer threads to terminate */
+	for ( ii = 0; ii<self->nb_writers; ++ii ) {
+		if ( pthread_join(self->threads[ii], NULL) ) RETURN_ERROR;
+	}
+	if ( pthread_join(self->copy_thread, NULL) ) RETURN_ERROR;
+	free(self->threads);
+	self->threads = NULL;
+	return 0;
+}
+
+
+/** Starts the drain threads of the burst buffer
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ */
+static int drainer_threads_start( ah5_t self )
+{
+	int ii;
+	self->sched_priority = -1;
+	self->sched_served = 0;
+	self->sched_waiting = 0;
+	self->sched_next = NULL;
+	self->drain_cmd = CMD_RUN;
+	self->drainers = malloc(self->nb_drainers*sizeof(pthread_t));
+	for ( ii = 0; ii<self->nb_drainers; ++ii ) {
+		if ( pthread_create(&(self->drainers[ii]), NULL, drainer_thread_loop, self) ) RETURN_ERROR;
+	}
+	return 0;
+}
+
+
+/** Waits for the writer threads to execute all sealed command lists and for
+ * the drain threads to move all their files to their final path
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ * @post the instance mutex is held
+ */
+static int drainer_threads_drain( ah5_t self )
+{
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	while ( self->drains || self->nb_draining ) {
+		LOG_STATUS("waiting for drain threads");
+		if ( pthread_cond_wait(&(self->drain_cond), &(self->mutex)) ) RETURN_ERROR;
+	}
+	return 0;
+}
+
+
+/** Stops the drain threads once they have drained all submitted files
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ * @pre the instance mutex is held
+ * @post the instance mutex is released
+ */
+static int drainer_threads_stop( ah5_t self )
+{
+	int ii;
+	self->drain_cmd = CMD_TERMINATE;
+	if ( pthread_cond_broadcast(&(self->drain_cond)) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	for ( ii = 0; ii<self->nb_drainers; ++ii ) {
+		if ( pthread_join(self->drainers[ii], NULL) ) RETURN_ERROR;
+	}
+	free(self->drainers);
+	self->drainers = NULL;
+	self->nb_drainers = 0;
+	return 0;
+}
 
-		/* when the command is to wait ... wait for it to change */
-		while ( self->thread_cmd ==  CMD_WAIT ) {
-			if ( pthread_cond_wait(&(self->cond), &(self->mutex)) ) SIGNAL_ERROR;
+
+#ifdef H5_HAVE_PARALLEL
+/** Builds the property lists used to write collectively
+ * @param self a pointer to the instance state
+ * @returns 0 on success, non-null on error
+ */
+static int collective_plists_update( ah5_t self )
+{
+	MPI_Info info;
+	if ( h5_lock() ) RETURN_ERROR;
+	if ( self->file_plist != H5P_DEFAULT && H5Pclose(self->file_plist) ) RETURN_ERROR;
+	if ( self->xfer_plist != H5P_DEFAULT && H5Pclose(self->xfer_plist) ) RETURN_ERROR;
+	self->file_plist = H5Pcreate(H5P_FILE_ACCESS);
+	if ( MPI_Info_create(&info) ) RETURN_ERROR;
+	/* two-phase aggregation is implemented by ROMIO collective buffering */
+	if ( MPI_Info_set(info, "romio_cb_write", self->two_phase? "enable" : "disable") ) RETURN_ERROR;
+	if ( H5Pset_fapl_mpio(self->file_plist, self->comm, info) ) RETURN_ERROR;
+	if ( MPI_Info_free(&info) ) RETURN_ERROR;
+	self->xfer_plist = H5Pcreate(H5P_DATASET_XFER);
+	if ( H5Pset_dxpl_mpio(self->xfer_plist, H5FD_MPIO_COLLECTIVE) ) RETURN_ERROR;
+	if ( H5Pset_dxpl_mpio_collective_opt(self->xfer_plist,
+			self->two_phase? H5FD_MPIO_COLLECTIVE_IO : H5FD_MPIO_INDIVIDUAL_IO) ) RETURN_ERROR;
+	if ( h5_unlock() ) RETURN_ERROR;
+	return 0;
+}
+#endif
+
+
+int ah5_init( ah5_t* pself )
+{
+	ah5_t self = malloc(sizeof(struct ah5));
+	cpu_set_t cpus;
+	int ii;
+	if ( H5open() ) RETURN_ERROR;
+	self->log_file = NULL;
+	self->log_verbosity = VERBOSITY_WARNING;
+	self->nb_writers = 1;
+	self->bind_writers = 0;
+	self->nb_lists = 1;
+	self->lists = calloc(self->nb_lists, sizeof(cmd_list_t));
+	self->fill_idx = 0;
+	self->write_idx = 0;
+	self->next_serial = 1;
+	self->scalar_as_array = 1;
+	self->parallel_copy = 1;
+	self->deferred_copy = 0;
+	self->append = 0;
+	self->flush_steps = 0;
+	self->rollover_steps = 0;
+	self->rollover_bytes = 0;
+	self->series = NULL;
+	self->nocopy = 0;
+	self->chunk_rank = 0;
+	self->chunked = 0;
+	self->compression = AH5_COMPRESS_NONE;
+	self->compression_level = 0;
+	self->shuffle = 0;
+	self->staging_flags = 0;
+	self->mem_limit = 0;
+	self->mem_used = 0;
+	self->backpressure = AH5_BACKPRESSURE_BLOCK;
+	self->spill_dir = NULL;
+	self->essential = 1;
+	self->delta = 0;
+	self->deltas = NULL;
+	self->delta_links = NULL;
+	self->delta_reused = NULL;
+	self->file_type = -1;
+	for ( ii = 0; ii<TYPE_CACHE_SIZE; ++ii ) self->types[ii].type = -1;
+	self->next_type = 0;
+	self->file_scale = 1;
+	self->file_offset = 0;
+	self->collective = 0;
+	self->two_phase = 1;
+	self->file_plist = H5P_DEFAULT;
+	self->image_block = 0;
+	self->image_sync = 0;
+	self->uring_depth = 0;
+	self->uring_buffer_size = 0;
+	self->xfer_plist = H5P_DEFAULT;
+	self->stats_spin = 0;
+	memset(&(self->stats), 0, sizeof(ah5_stats_t));
+	memset(&(self->last_stats), 0, sizeof(ah5_stats_t));
+	self->last_serial = 0;
+	self->stats_file = NULL;
+	self->stats_format = AH5_STATS_JSON;
+	self->nb_sealed = 0;
+	self->nb_written = 0;
+	self->callback = NULL;
+	self->callback_arg = NULL;
+	self->burst_dir = NULL;
+	self->burst_capacity = 0;
+	self->burst_ordered = 0;
+	self->burst_used = 0;
+	self->next_ticket = 0;
+	self->drained_ticket = 0;
+	self->drains = NULL;
+	self->nb_draining = 0;
+	self->drain_cmd = CMD_RUN;
+	self->drainers = NULL;
+	self->nb_drainers = 0;
+	if ( pthread_mutex_init(&(self->mutex), NULL) ) RETURN_ERROR;
+	if ( pthread_cond_init(&(self->cond), NULL) ) RETURN_ERROR;
+	if ( pthread_cond_init(&(self->free_cond), NULL) ) RETURN_ERROR;
+	if ( pthread_cond_init(&(self->copy_cond), NULL) ) RETURN_ERROR;
+	if ( pthread_cond_init(&(self->drain_cond), NULL) ) RETURN_ERROR;
+	/* by default, copy with all the CPUs the process is allowed to use */
+	self->pool.self = self;
+	self->pool.nb_threads = 0;
+	if ( !sched_getaffinity(0, sizeof(cpus), &cpus) ) self->pool.nb_threads = CPU_COUNT(&cpus)-1;
+	self->pool.cpus = NULL;
+	self->pool.generation = 0;
+	if ( pthread_mutex_init(&(self->pool.mutex), NULL) ) RETURN_ERROR;
+	if ( pthread_cond_init(&(self->pool.cond), NULL) ) RETURN_ERROR;
+	if ( pthread_cond_init(&(self->pool.done_cond), NULL) ) RETURN_ERROR;
+	if ( pool_start(&(self->pool)) ) RETURN_ERROR;
+	if ( writer_threads_start(self) ) RETURN_ERROR;
+	LOG_STATUS("initialized Async HDF5 instance");
+	*pself = self;
+	return 0;
+}
+
+
+#ifdef H5_HAVE_PARALLEL
+int ah5_init_mpi( ah5_t* pself, MPI_Comm comm )
+{
+	ah5_t self;
+	int thread_level;
+	if ( ah5_init(pself) ) return errno;
+	self = *pself;
+	/* the writer thread calls MPI concurrently with the application */
+	if ( MPI_Query_thread(&thread_level) ) RETURN_ERROR;
+	if ( thread_level < MPI_THREAD_MULTIPLE ) {
+		LOG_ERROR("collective writes require MPI to be initialized with MPI_THREAD_MULTIPLE");
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* use a dedicated communicator not to mix with application messages */
+	if ( MPI_Comm_dup(comm, &(self->comm)) ) RETURN_ERROR;
+	self->collective = 1;
+	if ( collective_plists_update(self) ) RETURN_ERROR;
+	LOG_STATUS("Async HDF5 instance writes collectively");
+	return 0;
+}
+
+
+int ah5_init_mpi_f( ah5_t* pself, MPI_Fint comm )
+{
+	return ah5_init_mpi(pself, MPI_Comm_f2c(comm));
+}
+#endif
+
+
+int ah5_set_loglvl( ah5_t self, ah5_verbosity_t log_lvl )
+{
+	__atomic_store_n(&(self->log_verbosity), log_lvl, __ATOMIC_RELAXED);
+	return 0;
+}
+
+
+int ah5_set_logfile( ah5_t self, char* log_file )
+{
+	int log_fd;
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	if ( self->log_file ) fclose(self->log_file);
+	log_fd = open(log_file, O_WRONLY|O_APPEND|O_CREAT|O_SYNC|O_DSYNC, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP);
+	if ( log_fd == -1 ) RETURN_ERROR;
+	self->log_file = fdopen(log_fd, "a");
+	if ( !self->log_file ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_statsfile( ah5_t self, char* stats_file, int format )
+{
+	if ( format != AH5_STATS_JSON && format != AH5_STATS_CSV ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	free(self->stats_file);
+	self->stats_file = NULL;
+	if ( stats_file ) {
+		self->stats_file = malloc(strlen(stats_file)+1);
+		strcpy(self->stats_file, stats_file);
+	}
+	self->stats_format = format;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_scalarray( ah5_t self, int scalar_as_array )
+{
+	self->scalar_as_array = scalar_as_array;
+	return 0;
+}
+
+
+int ah5_set_paracopy( ah5_t self, int parallel_copy )
+{
+	__atomic_store_n(&(self->parallel_copy), parallel_copy, __ATOMIC_RELAXED);
+	return 0;
+}
+
+
+int ah5_set_copiers( ah5_t self, int nb_copiers, int* cpus )
+{
+	if ( nb_copiers < 0 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* the pool can only be replaced once no copy is running */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	if ( pool_stop(&(self->pool)) ) {
+		int errno_save = errno;
+		pthread_mutex_unlock(&(self->mutex));
+		errno = errno_save;
+		RETURN_ERROR;
+	}
+	self->pool.nb_threads = nb_copiers;
+	free(self->pool.cpus);
+	self->pool.cpus = NULL;
+	if ( cpus ) {
+		self->pool.cpus = malloc(nb_copiers*sizeof(int));
+		memcpy(self->pool.cpus, cpus, nb_copiers*sizeof(int));
+	}
+	if ( pool_start(&(self->pool)) ) {
+		int errno_save = errno;
+		pthread_mutex_unlock(&(self->mutex));
+		errno = errno_save;
+		RETURN_ERROR;
+	}
+	LOG_DEBUG("using %d copy threads", nb_copiers);
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_writercpus( ah5_t self, int nb_cpus, int* cpus )
+{
+	int ii;
+	/* the writer threads can only be replaced once they are all idle */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	if ( writer_threads_stop(self) ) RETURN_ERROR;
+	self->bind_writers = ( nb_cpus > 0 );
+	CPU_ZERO(&(self->writer_cpus));
+	for ( ii = 0; ii<nb_cpus; ++ii ) {
+		CPU_SET(cpus[ii], &(self->writer_cpus));
+	}
+	if ( writer_threads_start(self) ) RETURN_ERROR;
+	LOG_DEBUG("binding the writer threads to %d CPUs", nb_cpus);
+	return 0;
+}
+
+
+int ah5_set_deferred( ah5_t self, int deferred_copy )
+{
+	self->deferred_copy = deferred_copy;
+	return 0;
+}
+
+
+int ah5_set_append( ah5_t self, int append, int flush_steps )
+{
+	series_t* retired = NULL;
+	if ( flush_steps < 0 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* the series can only be closed once it is fully written */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	if ( !append && self->series ) {
+		retired = series_retire(self->series);
+		self->series = NULL;
+	}
+	self->append = append;
+	self->flush_steps = flush_steps;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	if ( retired ) series_close(self, retired);
+	return 0;
+}
+
+
+int ah5_set_rollover( ah5_t self, int max_steps, size_t max_bytes )
+{
+	if ( max_steps < 0 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	self->rollover_steps = max_steps;
+	self->rollover_bytes = max_bytes;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_writers( ah5_t self, int nb_writers )
+{
+	if ( nb_writers < 1 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	if ( self->collective && nb_writers != 1 ) {
+		LOG_ERROR("collective writes require a single writer thread");
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* the writer threads can only be replaced once they are all idle */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	if ( writer_threads_stop(self) ) RETURN_ERROR;
+	self->nb_writers = nb_writers;
+	if ( writer_threads_start(self) ) RETURN_ERROR;
+	LOG_DEBUG("using %d writer threads", nb_writers);
+	return 0;
+}
+
+
+int ah5_set_collective( ah5_t self, int two_phase )
+{
+	/* the property lists can only be replaced once the writer is idle */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	self->two_phase = two_phase;
+#ifdef H5_HAVE_PARALLEL
+	if ( self->collective && collective_plists_update(self) ) {
+		int errno_save = errno;
+		pthread_mutex_unlock(&(self->mutex));
+		errno = errno_save;
+		RETURN_ERROR;
+	}
+#endif
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_fileimage( ah5_t self, int image, size_t block_size, int sync )
+{
+	if ( image && self->collective ) {
+		LOG_ERROR("files written collectively can not be built in memory");
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* the property list can only be replaced once the writer is idle */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	if ( !block_size ) block_size = IMAGE_BLOCK_SIZE;
+	block_size = (block_size+IMAGE_ALIGNMENT-1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+	self->image_block = image? block_size : 0;
+	self->image_sync = sync;
+	if ( file_plist_update(self) ) {
+		int errno_save = errno;
+		pthread_mutex_unlock(&(self->mutex));
+		errno = errno_save;
+		RETURN_ERROR;
+	}
+	LOG_DEBUG("building files in memory: %d", image);
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_uring( ah5_t self, int queue_depth, size_t buffer_size )
+{
+	if ( queue_depth < 0 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	if ( queue_depth && self->collective ) {
+		LOG_ERROR("files written collectively can not use io_uring");
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+#ifdef AH5_HAVE_URING
+	if ( queue_depth && !uring_available() ) {
+		LOG_WARNING("io_uring not available, using the default file driver");
+		queue_depth = 0;
+	}
+#else
+	if ( queue_depth ) {
+		LOG_WARNING("built without io_uring support, using the default file driver");
+		queue_depth = 0;
+	}
+#endif
+	/* the property list can only be replaced once the writer is idle */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	self->uring_depth = queue_depth;
+	self->uring_buffer_size = buffer_size;
+	if ( file_plist_update(self) ) {
+		int errno_save = errno;
+		pthread_mutex_unlock(&(self->mutex));
+		errno = errno_save;
+		RETURN_ERROR;
+	}
+	LOG_DEBUG("using io_uring with %d writes in flight", queue_depth);
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_nocopy( ah5_t self, int nocopy )
+{
+	self->nocopy = nocopy;
+	return 0;
+}
+
+
+int ah5_set_essential( ah5_t self, int essential )
+{
+	self->essential = essential;
+	return 0;
+}
+
+
+int ah5_set_delta( ah5_t self, int delta )
+{
+	if ( delta && !self->deltas ) self->deltas = calloc(DELTA_BUCKETS, sizeof(delta_t*));
+	self->delta = delta;
+	return 0;
+}
+
+
+int ah5_set_filetype( ah5_t self, hid_t type, double scale, double offset )
+{
+	hid_t file_type = -1;
+	if ( type >= 0 ) {
+		if ( scale == 0 ) {
+			errno = EINVAL;
+			RETURN_ERROR;
 		}
-		LOG_DEBUG("async HDF5 thread executing command");
-		/* if the command is to stop ... stop */
-		if ( self->thread_cmd == CMD_TERMINATE ) {
-			LOG_DEBUG("async HDF5 thread executing terminate command");
+		if ( h5_lock() ) RETURN_ERROR;
+		if ( H5Tequal(type, H5T_NATIVE_FLOAT) > 0 ) {
+			file_type = H5T_NATIVE_FLOAT;
+		} else if ( H5Tequal(type, H5T_NATIVE_SHORT) > 0 ) {
+			file_type = H5T_NATIVE_SHORT;
+		} else if ( H5Tequal(type, H5T_NATIVE_INT) > 0 ) {
+			file_type = H5T_NATIVE_INT;
+		}
+		if ( h5_unlock() ) RETURN_ERROR;
+		if ( file_type < 0 ) {
+			LOG_ERROR("unsupported file type, expected native float, short or int");
+			errno = EINVAL;
+			RETURN_ERROR;
+		}
+	}
+	self->file_type = file_type;
+	self->file_scale = ( file_type < 0 )? 1 : scale;
+	self->file_offset = ( file_type < 0 )? 0 : offset;
+	return 0;
+}
+
+
+int ah5_set_chunking( ah5_t self, int rank, hsize_t* chunk_dims )
+{
+	int ii;
+	if ( rank < 0 || rank > MAX_RANK ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	self->chunked = ( rank != 0 );
+	self->chunk_rank = rank;
+	for ( ii = 0; ii<rank; ++ii ) {
+		self->chunk_dims[ii] = chunk_dims[ii];
+	}
+	return 0;
+}
+
+
+int ah5_set_compression( ah5_t self, ah5_compression_t method, int level, int shuffle )
+{
+	self->compression = method;
+	self->compression_level = level;
+	self->shuffle = shuffle;
+	return 0;
+}
+
+
+int ah5_set_staging( ah5_t self, int flags, size_t reserve )
+{
+	size_t ii;
+	/* the staging buffers can only be remapped once they are all free */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		if ( self->lists[ii].state == LIST_LOADED ) {
 			pthread_mutex_unlock(&(self->mutex));
-			return NULL;
+			LOG_ERROR("the staging buffers can not change while loaded data is not released");
+			errno = EBUSY;
+			RETURN_ERROR;
 		}
-		/* otherwise, the command is to execute the write list */
-		assert( self->thread_cmd == CMD_WRITE );
-		LOG_DEBUG("async HDF5 thread executing write command");
-
-		start_time = clockget();
-		file_id = H5Fcreate( self->file_name, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT );
-		
-		for ( did=0; did<self->data_size; ++did ) {
-			hid_t space_id, plist_id, dset_id;
-			LOG_DEBUG("async HDF5 writing data[%lu]: %s of rank %u", (unsigned long)did, self->data[did].name, (unsigned)self->data[did].rank);
-			space_id = H5Screate_simple(self->data[did].rank, self->data[did].dims, NULL);
-			plist_id = H5Pcreate(CLS_DSET_CREATE);
-			if ( H5Pset_layout(plist_id, H5D_CONTIGUOUS) ) SIGNAL_ERROR;
-#if ( H5Dcreate_vers == 2 )
-			dset_id = H5Dcreate2(file_id, self->data[did].name, self->data[did].type,
-					space_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-#else
-			dset_id = H5Dcreate( file_id, self->data[did].name, self->data[did].type,
-					space_id, H5P_DEFAULT);
-#endif
-			if ( H5Dwrite(dset_id, self->data[did].type, H5S_ALL, H5S_ALL, H5P_DEFAULT,
-					self->data[did].buf) ) SIGNAL_ERROR;
-			if ( H5Dclose(dset_id) ) SIGNAL_ERROR;
-			if ( H5Pclose(plist_id) ) SIGNAL_ERROR;
-			if ( H5Sclose(space_id) ) SIGNAL_ERROR;
+	}
+	if ( flags != self->staging_flags ) {
+		for ( ii = 0; ii<self->nb_lists; ++ii ) {
+			arena_release(self, &(self->lists[ii].data_buffer));
+		}
+		self->staging_flags = flags;
+	}
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		if ( arena_reserve(self, &(self->lists[ii].data_buffer), reserve, 0) ) {
+			int errno_save = errno;
+			pthread_mutex_unlock(&(self->mutex));
+			errno = errno_save;
+			RETURN_ERROR;
+		}
+	}
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_memlimit( ah5_t self, size_t mem_limit )
+{
+	self->mem_limit = mem_limit;
+	return 0;
+}
+
+
+int ah5_set_backpressure( ah5_t self, int policy, char* spill_dir )
+{
+	if ( policy < AH5_BACKPRESSURE_BLOCK || policy > AH5_BACKPRESSURE_SPILL ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	self->backpressure = policy;
+	free(self->spill_dir);
+	self->spill_dir = NULL;
+	if ( spill_dir ) {
+		self->spill_dir = malloc(strlen(spill_dir)+1);
+		strcpy(self->spill_dir, spill_dir);
+	}
+	return 0;
+}
+
+
+int ah5_set_burstbuffer( ah5_t self, char* local_dir, size_t capacity, int nb_drainers,
+		int ordered )
+{
+	if ( local_dir && nb_drainers < 1 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* the file being filled may already be in the burst buffer */
+	if ( self->lists[self->fill_idx].state == LIST_FILLING ) {
+		LOG_ERROR("the burst buffer can not change while a command list is filled");
+		errno = EBUSY;
+		RETURN_ERROR;
+	}
+	/* the files in the current burst buffer are drained with its settings */
+	if ( drainer_threads_drain(self) ) RETURN_ERROR;
+	if ( drainer_threads_stop(self) ) RETURN_ERROR;
+	free(self->burst_dir);
+	self->burst_dir = NULL;
+	if ( local_dir ) {
+		self->burst_dir = malloc(strlen(local_dir)+1);
+		strcpy(self->burst_dir, local_dir);
+	}
+	self->burst_capacity = capacity;
+	self->burst_ordered = ordered;
+	self->drained_ticket = self->next_ticket;
+	self->nb_drainers = local_dir? nb_drainers : 0;
+	if ( drainer_threads_start(self) ) RETURN_ERROR;
+	LOG_DEBUG("using %d drain threads", self->nb_drainers);
+	return 0;
+}
+
+
+int ah5_drain( ah5_t self )
+{
+	if ( drainer_threads_drain(self) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_scheduler( ah5_t self, int priority )
+{
+	if ( sched_join(self, priority) ) RETURN_ERROR;
+	LOG_DEBUG("using the shared scheduler with priority %d", priority);
+	return 0;
+}
+
+
+int ah5_set_schedlimits( ah5_t self, int nb_writers, size_t mem_limit )
+{
+	if ( nb_writers < 1 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	if ( pthread_mutex_lock(&(scheduler.mutex)) ) RETURN_ERROR;
+	scheduler.nb_slots = nb_writers;
+	scheduler.mem_limit = mem_limit;
+	if ( pthread_cond_broadcast(&(scheduler.cond)) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(scheduler.mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_set_depth( ah5_t self, int depth )
+{
+	size_t ii;
+	if ( depth < 1 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* the slots can only be reorganized once they are all free */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		if ( self->lists[ii].state == LIST_FILLING || self->lists[ii].state == LIST_LOADED ) {
+			pthread_mutex_unlock(&(self->mutex));
+			LOG_ERROR("the command list slots can not change while a list is filled or loaded");
+			errno = EBUSY;
+			RETURN_ERROR;
 		}
+	}
+	for ( ii = depth; ii<self->nb_lists; ++ii ) {
+		list_free(self, &(self->lists[ii]));
+	}
+	self->lists = realloc(self->lists, depth*sizeof(cmd_list_t));
+	for ( ii = self->nb_lists; ii<(size_t)depth; ++ii ) {
+		memset(&(self->lists[ii]), 0, sizeof(cmd_list_t));
+	}
+	self->nb_lists = depth;
+	self->fill_idx = 0;
+	self->write_idx = 0;
+	LOG_DEBUG("using %d command list slots", depth);
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
 
-		LOG_DEBUG("async HDF5 closing file");
-		if ( H5Fclose(file_id) ) SIGNAL_ERROR;
-		LOG_DEBUG("async HDF5 write duration: %" PRId64 "us", clockget()-start_time);
 
-		/* once the write list has been fully executed, tell oneself to wait for the next one */
-		self->thread_cmd = CMD_WAIT;
-		/* and wake up the main thread potentially waiting for us */
-		if ( pthread_cond_signal(&(self->cond)) ) SIGNAL_ERROR;
-	}
+int ah5_set_callback( ah5_t self, ah5_callback_t callback, void* arg )
+{
+	/* the writer threads read it under the mutex */
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	self->callback = callback;
+	self->callback_arg = arg;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
 }
 
 
-/** This function has the exact same prototype as memcpy and does the exact same thing,
- * except it does it in parallel
- * @param dest the destination of the copy
- * @param src the source of the copy
- * @param size the number of bytes to copy
- * @return a pointer to dest
- */
-static void* memcpy_omp( void* dest, void* src, size_t size )
+int ah5_get_inflight( ah5_t self, int* nb_used )
 {
-#ifdef _OPENMP
-	size_t thread_disp[MAX_NB_THREAD+1];
-	int nbthread = omp_get_num_threads();
-	int tid;
-	if ( nbthread > MAX_NB_THREAD ) nbthread = MAX_NB_THREAD;
-	thread_disp[0] = 0;
-	for ( tid = 0; tid<nbthread; ++tid ) {
-		size_t thread_size = size / (4*1024); /* size in ~pages (4k) */
-		/* get a fair share of pages (rounded above) amongst remaining threads */
-		thread_size = ( (thread_size+nbthread-tid-1) / (nbthread-tid) );
-		thread_size *= (4*1024); /* get back as Bytes */
-		size -= thread_size; /* remove from the size remaining to write */
-		if ( size < (4*1024) ) { /* if the remaining size is not a full page */
-			thread_size += size; /* write it */
-			size = 0;
-		}
-		thread_disp[tid+1] = thread_disp[tid]+thread_size;
-	}
-	assert(size==0);
-	#pragma omp parallel for schedule(static)
-	for (tid = 0; tid<nbthread; ++tid ) {
-		memcpy(((char*)dest)+thread_disp[tid], ((char*)src)+thread_disp[tid],
-				thread_disp[tid+1]-thread_disp[tid]);
-	}
-	return dest;
-#else
-	return memcpy(dest, src, size);
-#endif
+	/* only the calling thread seals command lists and fills the current slot */
+	*nb_used = self->nb_sealed - __atomic_load_n(&(self->nb_written), __ATOMIC_ACQUIRE);
+	if ( self->lists[self->fill_idx].state == LIST_FILLING ) ++*nb_used;
+	return 0;
 }
 
 
-/** Copies a slice of a nD array (in fact a block) from src to dest.
- * @param dest the destination of the block (contiguous)
- * @param src the source array where the block is
- * @param type the type of elements in the array
- * @param rank the number of dimensions of the array
- * @param sizes the sizes of the array in each dimension
- * @param lbounds the lower bounds of the block in each dimension
- * @param ubounds the upper bounds of the block in each dimension
- * @param parallelism whether to do the copy in parallel
- * @return dest
- */
-static void* slicecpy( void* dest, void* src, hid_t type, unsigned rank, hsize_t* sizes,
-		hsize_t* lbounds, hsize_t* ubounds, int parallelism )
+int ah5_test( ah5_t self, int* done )
 {
-	size_t ii, src_block_size, dst_block_size;
+	*done = ( __atomic_load_n(&(self->nb_written), __ATOMIC_ACQUIRE) == self->nb_sealed );
+	return 0;
+}
 
-	if ( rank == 0 ) {
-		if ( parallelism ) {
-			memcpy_omp(dest, src, H5Tget_size(type));
-		} else {
-			memcpy(dest, src, H5Tget_size(type));
-		}
-		return dest;
-	}
 
-	src_block_size = 1;
-	dst_block_size = 1;
-	for ( ii=1; ii<rank; ++ii ) {
-		src_block_size *= sizes[ii];
-		dst_block_size *= (ubounds[ii]-lbounds[ii]);
+int ah5_wait( ah5_t self, double timeout, int* done )
+{
+	struct timespec deadline;
+	int64_t start_time;
+	int err = 0;
+	if ( ah5_test(self, done) ) RETURN_ERROR;
+	if ( *done || timeout == 0 ) return 0;
+	start_time = clockget();
+	/* the condition variables use the default realtime clock */
+	if ( timeout > 0 ) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (time_t)timeout;
+		deadline.tv_nsec += (long)((timeout-(time_t)timeout)*1e9);
+		if ( deadline.tv_nsec >= 1000000000L ) {
+			++deadline.tv_sec;
+			deadline.tv_nsec -= 1000000000L;
+		}
 	}
-
-	if ( src_block_size == dst_block_size ) {
-		if ( parallelism ) {
-			memcpy_omp(dest, ((char*)src)+src_block_size*lbounds[0]*H5Tget_size(type),
-					H5Tget_size(type)*src_block_size*(ubounds[0]-lbounds[0]) );
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	while ( !( *done = ( self->nb_written == self->nb_sealed ) ) && err != ETIMEDOUT ) {
+		if ( timeout < 0 ) {
+			err = pthread_cond_wait(&(self->free_cond), &(self->mutex));
 		} else {
-			memcpy(dest, ((char*)src)+src_block_size*lbounds[0]*H5Tget_size(type),
-					H5Tget_size(type)*src_block_size*(ubounds[0]-lbounds[0]) );
+			err = pthread_cond_timedwait(&(self->free_cond), &(self->mutex), &deadline);
 		}
-	} else {
-		if ( parallelism ) {
-			#pragma omp for
-			for ( ii = lbounds[0]; ii<ubounds[0]; ++ii ) {
-				slicecpy(
-						((char*)dest)+dst_block_size*(ii-lbounds[0])*H5Tget_size(type),
-						((char*)src)+src_block_size*ii*H5Tget_size(type),
-						type, rank-1, sizes+1, lbounds+1, ubounds+1,
-						0 );
-			}
-		} else {
-			for ( ii = lbounds[0]; ii<ubounds[0]; ++ii ) {
-				slicecpy(
-						((char*)dest)+dst_block_size*(ii-lbounds[0])*H5Tget_size(type),
-						((char*)src)+src_block_size*ii*H5Tget_size(type),
-						type, rank-1, sizes+1, lbounds+1, ubounds+1,
-						0 );
-			}
+		if ( err && err != ETIMEDOUT ) {
+			errno = err;
+			RETURN_ERROR;
 		}
 	}
-	return dest;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	stats_record(self, NULL, AH5_PHASE_WAIT, start_time);
+	return 0;
 }
 
 
-/** Waits for the worker thread to finish its previous run
- * @param self a pointer to the instance state
- * @returns 0 on success, non-null on error
- */
-inline static int writer_thread_wait( ah5_t self )
+int ah5_get_stats( ah5_t self, ah5_stats_t* total, ah5_stats_t* last )
 {
-	size_t ii;
-	/* wait for the writer thread */
 	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
-	/* wait for a potential previous write command to be executed */
-	while ( self->thread_cmd ==  CMD_WRITE ) {
-		LOG_STATUS("waiting for writer thread");
-		if ( pthread_cond_wait(&(self->cond), &(self->mutex)) ) RETURN_ERROR;
-	}
-	/* free the previously allocated memory for field names */
-	for ( ii = 0; ii<self->data_size; ++ii ) {
-		free(self->data[ii].name);
+	stats_lock(self);
+	if ( total ) *total = self->stats;
+	stats_unlock(self);
+	if ( last ) *last = self->last_stats;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	if ( total ) stats_derive(total);
+	if ( last ) stats_derive(last);
+	return 0;
+}
+
+
+int ah5_get_vartoken( ah5_t self, ah5_token_t* token )
+{
+	cmd_list_t* list = &(self->lists[self->fill_idx]);
+	if ( list->state != LIST_FILLING || !list->data_size ) {
+		errno = EINVAL;
+		RETURN_ERROR;
 	}
-	/* reset the number of records */
-	self->data_size = 0;
+	*token = (ah5_token_t)((list->serial << TOKEN_VAR_BITS) | list->data_size);
 	return 0;
 }
 
 
-int ah5_init( ah5_t* pself )
+int ah5_get_listtoken( ah5_t self, ah5_token_t* token )
 {
-	ah5_t self = malloc(sizeof(struct ah5));
-	if ( H5open() ) RETURN_ERROR;
-	self->file_name = NULL;
-	self->log_file = NULL;
-	self->log_verbosity = VERBOSITY_WARNING;
-	self->thread_cmd = CMD_WAIT;
-	self->data_buffer = NULL;
-	self->data = NULL;
-	self->data_size = 0;
-	self->scalar_as_array = 1;
-	self->parallel_copy = 1;
-	if ( pthread_mutex_init(&(self->mutex), NULL) ) RETURN_ERROR;
-	if ( pthread_cond_init(&(self->cond), NULL) ) RETURN_ERROR;
-	if ( pthread_create(&(self->thread), NULL, writer_thread_loop, self) ) RETURN_ERROR;
-	LOG_STATUS("initialized Async HDF5 instance");
-	*pself = self;
+	cmd_list_t* list = &(self->lists[self->fill_idx]);
+	if ( list->state != LIST_FILLING ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	*token = (ah5_token_t)(list->serial << TOKEN_VAR_BITS);
 	return 0;
 }
 
 
-int ah5_set_loglvl( ah5_t self, ah5_verbosity_t log_lvl )
+int ah5_token_test( ah5_t self, ah5_token_t token, int* released )
 {
 	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
-	self->log_verbosity = log_lvl;
+	*released = token_released(self, token);
 	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	if ( *released < 0 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
 	return 0;
 }
 
 
-int ah5_set_logfile( ah5_t self, char* log_file )
+int ah5_token_wait( ah5_t self, ah5_token_t token )
 {
-	int log_fd;
+	int released;
+	int64_t start_time = clockget();
 	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
-	if ( self->log_file ) fclose(self->log_file);
-	log_fd = open(log_file, O_WRONLY|O_APPEND|O_CREAT|O_SYNC|O_DSYNC, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP);
-	if ( log_fd == -1 ) RETURN_ERROR;
-	self->log_file = fdopen(log_fd, "a");
-	if ( !self->log_file ) RETURN_ERROR;
+	while ( !(released = token_released(self, token)) ) {
+		if ( pthread_cond_wait(&(self->free_cond), &(self->mutex)) ) RETURN_ERROR;
+	}
 	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	stats_record(self, NULL, AH5_PHASE_WAIT, start_time);
+	if ( released < 0 ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
 	return 0;
 }
 
 
-int ah5_set_scalarray( ah5_t self, int scalar_as_array )
+/** Checks whether an array is still needed by a sealed command list
+ * @param self a pointer to the instance state
+ * @param buf the array to check
+ * @returns 1 if released, 0 if not
+ * @pre the instance mutex is held
+ */
+static int data_released( ah5_t self, void* buf )
+{
+	size_t ii, did;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		cmd_list_t* list = &(self->lists[ii]);
+		if ( list->state != LIST_READY && list->state != LIST_WRITING ) continue;
+		for ( did = 0; did<list->data_size; ++did ) {
+			if ( list->data[did].buf == buf && !list->data[did].released ) return 0;
+		}
+	}
+	return 1;
+}
+
+
+int ah5_data_test( ah5_t self, void* data, int* released )
 {
 	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
-	self->scalar_as_array = scalar_as_array;
+	*released = data_released(self, data);
 	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
 	return 0;
 }
 
 
-int ah5_set_paracopy( ah5_t self, int parallel_copy )
+int ah5_data_wait( ah5_t self, void* data )
 {
+	int64_t start_time = clockget();
 	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
-	self->parallel_copy = parallel_copy;
+	while ( !data_released(self, data) ) {
+		if ( pthread_cond_wait(&(self->free_cond), &(self->mutex)) ) RETURN_ERROR;
+	}
 	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	stats_record(self, NULL, AH5_PHASE_WAIT, start_time);
 	return 0;
 }
 
 
 int ah5_finalize( ah5_t self )
 {
-	/* wait for the writer thread to finish its work */
-	if ( writer_thread_wait(self) ) RETURN_ERROR;
-	/* tell the writer thread to terminate */
-	self->thread_cmd = CMD_TERMINATE;
-	if ( pthread_cond_signal(&(self->cond)) ) RETURN_ERROR;
-	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
-	/* wait for the writer thread to terminate */
-	if ( pthread_join( self->thread, NULL) ) RETURN_ERROR;
+	size_t ii;
+	/* wait for the writer threads to finish their work */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	if ( writer_threads_stop(self) ) RETURN_ERROR;
+	/* then for all files to leave the burst buffer */
+	if ( drainer_threads_drain(self) ) RETURN_ERROR;
+	if ( drainer_threads_stop(self) ) RETURN_ERROR;
+	free(self->burst_dir);
+	if ( sched_join(self, -1) ) RETURN_ERROR;
+	if ( pool_stop(&(self->pool)) ) RETURN_ERROR;
+	free(self->pool.cpus);
+	if ( self->series ) series_close(self, self->series);
+	if ( self->stats_file ) {
+		if ( stats_dump(self) ) RETURN_ERROR;
+		free(self->stats_file);
+	}
 	/* free all memory */
-	free(self->data);
-	free(self->data_buffer);
-	free(self->file_name);
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		list_free(self, &(self->lists[ii]));
+	}
+	free(self->lists);
+	free(self->spill_dir);
+	if ( h5_lock() ) RETURN_ERROR;
+	for ( ii = 0; self->deltas && ii<DELTA_BUCKETS; ++ii ) {
+		while ( self->deltas[ii] ) {
+			delta_t* next = self->deltas[ii]->next;
+			if ( H5Tclose(self->deltas[ii]->type) ) RETURN_ERROR;
+			free(self->deltas[ii]->name);
+			free(self->deltas[ii]->file_name);
+			free(self->deltas[ii]);
+			self->deltas[ii] = next;
+		}
+	}
+	free(self->deltas);
+	delta_links_free(self->delta_links);
+	delta_links_free(self->delta_reused);
+	if ( self->file_plist != H5P_DEFAULT && H5Pclose(self->file_plist) ) RETURN_ERROR;
+	if ( self->xfer_plist != H5P_DEFAULT && H5Pclose(self->xfer_plist) ) RETURN_ERROR;
+	if ( h5_unlock() ) RETURN_ERROR;
+#ifdef H5_HAVE_PARALLEL
+	if ( self->collective && MPI_Comm_free(&(self->comm)) ) RETURN_ERROR;
+#endif
 	LOG_STATUS("finalized Async HDF5 instance");
 	if ( self->log_file ) fclose(self->log_file);
 	free(self);
@@ -504,97 +6441,623 @@ int ah5_finalize( ah5_t self )
 }
 
 
-int ah5_start( ah5_t self, char* file_name )
+/** Replaces the external links into a file about to be overwritten by copies
+ * of the datasets they point to, and stops linking into that file
+ * @param self a pointer to the instance state
+ * @param file_name the name of the file about to be overwritten
+ * @returns 0 on success, non-null on error
+ * @pre the writer thread is ready
+ */
+static int delta_unlink( ah5_t self, const char* file_name )
+{
+	delta_link_t** prev = &(self->delta_links);
+	delta_link_t* link;
+	hid_t target_id = -1;
+	int linked = 0;
+	for ( link = self->delta_links; link; link = link->next ) {
+		if ( !strcmp(link->file_name, file_name) || !strcmp(link->target, file_name) ) break;
+	}
+	if ( !link ) return 0;
+	/* the linking files and their targets must be complete and in place */
+	if ( drainer_threads_drain(self) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	while ( (link = *prev) ) {
+		/* the links of the overwritten file itself disappear with it */
+		if ( strcmp(link->target, file_name) && strcmp(link->file_name, file_name) ) {
+			prev = &(link->next);
+			continue;
+		}
+		if ( !strcmp(link->target, file_name) && !access(link->file_name, F_OK)
+				&& !access(file_name, F_OK) ) {
+			hid_t file_id;
+			LOG_DEBUG("copying %s into %s before %s is overwritten", link->name,
+					link->file_name, file_name);
+			if ( h5_lock() ) RETURN_ERROR;
+			if ( target_id < 0 ) target_id = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+			if ( target_id < 0 ) RETURN_ERROR;
+			file_id = H5Fopen(link->file_name, H5F_ACC_RDWR, H5P_DEFAULT);
+			if ( file_id < 0 ) RETURN_ERROR;
+			if ( H5Ldelete(file_id, link->name, H5P_DEFAULT) ) RETURN_ERROR;
+			if ( H5Ocopy(target_id, link->name, file_id, link->name, H5P_DEFAULT,
+					H5P_DEFAULT) ) RETURN_ERROR;
+			if ( H5Fclose(file_id) ) RETURN_ERROR;
+			if ( h5_unlock() ) RETURN_ERROR;
+			linked = 1;
+		}
+		*prev = link->next;
+		link->next = NULL;
+		delta_links_free(link);
+	}
+	if ( target_id >= 0 ) {
+		if ( h5_lock() ) RETURN_ERROR;
+		if ( H5Fclose(target_id) ) RETURN_ERROR;
+		if ( h5_unlock() ) RETURN_ERROR;
+	}
+	/* the name is likely to be overwritten again, e.g. by alternating
+	 * restart files */
+	if ( linked && !delta_reused(self, file_name) ) {
+		link = calloc(1, sizeof(delta_link_t));
+		link->target = malloc(strlen(file_name)+1);
+		strcpy(link->target, file_name);
+		link->next = self->delta_reused;
+		self->delta_reused = link;
+	}
+	return 0;
+}
+
+
+/** Starts a command list, waits for a command list slot to be freed if they
+ * are all in use
+ * @param self a pointer to the instance state
+ * @param file_name the name of the file to write or to load
+ * @param load whether the list loads its Data from the file
+ * @returns 0 on success, non-null on error
+ */
+static int list_start( ah5_t self, char* file_name, int load )
 {
-	/* wait for the writer thread to finish its work */
-	if ( writer_thread_wait(self) ) RETURN_ERROR;
-	LOG_DEBUG("starting new command list");
+	cmd_list_t* list;
+	int64_t start_time = clockget();
+	/* files linking into the one about to be overwritten must not change */
+	if ( !load && delta_unlink(self, file_name) ) RETURN_ERROR;
+	/* wait for the next slot to be freed by the writer thread */
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	list = &(self->lists[self->fill_idx]);
+	while ( list->state != LIST_FREE ) {
+		LOG_STATUS("waiting for writer thread");
+		if ( pthread_cond_wait(&(self->free_cond), &(self->mutex)) ) RETURN_ERROR;
+	}
+	memset(&(list->stats), 0, sizeof(ah5_stats_t));
+	stats_record(self, list, AH5_PHASE_WAIT, start_time);
+	list->state = LIST_FILLING;
+	list->serial = self->next_serial++;
+	/* a loaded file is only opened once the list is sealed */
+	list->load = load;
+	list->append = load? 0 : self->append;
+	list->submitted = 0;
+	list->created = 0;
+	list->early = 0;
+	list->early_stopped = 0;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	LOG_DEBUG("starting new command list in slot %lu", (unsigned long)self->fill_idx);
+	list_clear(list);
 	/* store the file name */
-	self->file_name = realloc(self->file_name, strlen(file_name)+1);
-	strcpy(self->file_name, file_name);
+	list->file_name = realloc(list->file_name, strlen(file_name)+1);
+	strcpy(list->file_name, file_name);
+	STATS_COUNT(self, list, blocked_us, (uint64_t)(clockget()-start_time));
 	return 0;
 }
 
 
+int ah5_start( ah5_t self, char* file_name )
+{
+	return list_start(self, file_name, 0);
+}
+
+
 int ah5_write( ah5_t self, void* data, char* name, hid_t type, int rank,
 		hsize_t* dims, hsize_t* lbounds, hsize_t* ubounds )
 {
+	return ah5_write_global(self, data, name, type, rank, dims, lbounds, ubounds,
+			NULL, NULL);
+}
+
+
+int ah5_write_global( ah5_t self, void* data, char* name, hid_t type, int rank,
+		hsize_t* dims, hsize_t* lbounds, hsize_t* ubounds, hsize_t* global_dims,
+		hsize_t* offset )
+{
+	return ah5_write_strided(self, data, name, type, rank, dims, NULL, lbounds, ubounds,
+			global_dims, offset);
+}
+
+
+int ah5_write_strided( ah5_t self, void* data, char* name, hid_t type, int rank,
+		hsize_t* dims, int64_t* strides, hsize_t* lbounds, hsize_t* ubounds,
+		hsize_t* global_dims, hsize_t* offset )
+{
+	cmd_list_t* list = &(self->lists[self->fill_idx]);
+	hsize_t hsize_zero = 0;
+	hsize_t hsize_one = 1;
+	convert_t convert;
+	type_info_t* info;
+	size_t type_size;
+	ptrdiff_t packed;
+	int contiguous = 1;
+	int64_t start_time = clockget();
 	int ii;
 	LOG_DEBUG("adding a write command to the list");
+	if ( list->load ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	if ( list->data_size >= MAX_COMMANDS ) {
+		LOG_ERROR("too many commands in the command list for %s", list->file_name);
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	for ( ii = 0; global_dims && ii<rank; ++ii ) {
+		if ( (offset? offset[ii] : 0) + ubounds[ii]-lbounds[ii] > global_dims[ii] ) {
+			LOG_ERROR("data %s does not fit in its dataset in dimension %d", name, ii);
+			errno = EINVAL;
+			RETURN_ERROR;
+		}
+	}
+	/* the type is converted while the data is staged */
+	info = type_lookup(self, type, self->file_type);
+	if ( !info ) RETURN_ERROR;
+	convert.kernel = NULL;
+	type_size = 0;
+	convert.src_size = info->size;
+	if ( self->file_type >= 0 && ( !info->same
+			|| self->file_scale != 1 || self->file_offset != 0 ) ) {
+		convert.kernel = info->kernel;
+		type_size = info->file_size;
+	}
+	if ( type_size && !convert.kernel ) {
+		LOG_ERROR("data %s can not be converted to the file type", name);
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	convert.dest_size = type_size? type_size : convert.src_size;
+	convert.scale = self->file_scale;
+	convert.offset = self->file_offset;
 	/* increase the array containing all write commands */
-	++self->data_size;
-	self->data = realloc(self->data, (self->data_size)*sizeof(data_id_t));
+	list_reserve(list, list->data_size+1);
+	++list->data_size;
 	if ( self->scalar_as_array ) {
 		/* replace scalars by rank 1 array */
-		hsize_t hsize_zero = 0;
-		hsize_t hsize_one = 1;
 		if ( rank == 0 ) {
 			rank = 1;
 			dims = &hsize_one;
 			lbounds = &hsize_zero;
 			ubounds = &hsize_one;
+			global_dims = NULL;
+			offset = NULL;
+			strides = NULL;
 		}
 	}
 	/* save the info in the last element of the array */
-	self->data[self->data_size-1].buf = data;
-	self->data[self->data_size-1].rank = rank;
+	list->data[list->data_size-1].buf = data;
+	list->data[list->data_size-1].rank = rank;
+	for ( ii = 0; ii<rank; ++ii ) {
+		list->data[list->data_size-1].dims[ii] = dims[ii];
+		list->data[list->data_size-1].lbounds[ii] = lbounds[ii];
+		list->data[list->data_size-1].ubounds[ii] = ubounds[ii];
+		/* by default, the written part is the whole dataset */
+		list->data[list->data_size-1].global_dims[ii] =
+				global_dims? global_dims[ii] : ubounds[ii]-lbounds[ii];
+		list->data[list->data_size-1].offset[ii] = offset? offset[ii] : 0;
+	}
+	/* the distances between elements in the user array, in bytes */
+	packed = convert.src_size;
+	for ( ii = rank-1; ii>=0; --ii ) {
+		ptrdiff_t stride = strides? strides[ii]*(ptrdiff_t)convert.src_size : packed;
+		/* the stride of a dimension of size 1 does not matter */
+		if ( dims[ii] > 1 && stride != packed ) contiguous = 0;
+		list->data[list->data_size-1].strides[ii] = ( dims[ii] > 1 )? stride : packed;
+		packed *= dims[ii];
+	}
+	list->data[list->data_size-1].name = list_name(list, name);
+	list->data[list->data_size-1].type = convert.kernel? self->file_type : type;
+	list->data[list->data_size-1].type_size = convert.dest_size;
+	list->data[list->data_size-1].convert = convert;
+	/* a converted or non-contiguous Data has to be staged */
+	list->data[list->data_size-1].nocopy = self->nocopy && !convert.kernel && contiguous;
+	list->data[list->data_size-1].essential = self->essential;
+	list->data[list->data_size-1].dropped = 0;
+	list->data[list->data_size-1].delta = self->delta;
+	list->data[list->data_size-1].linked = 0;
+	/* filters require a chunked dataset, scalars can not be chunked */
+	list->data[list->data_size-1].chunked = rank && ( self->chunked || self->shuffle
+			|| self->compression != AH5_COMPRESS_NONE );
 	for ( ii = 0; ii<rank; ++ii ) {
-		self->data[self->data_size-1].dims[ii] = dims[ii];
-		self->data[self->data_size-1].lbounds[ii] = lbounds[ii];
-		self->data[self->data_size-1].ubounds[ii] = ubounds[ii];
+		/* use the chunk dimensions if they match, otherwise compute them */
+		list->data[list->data_size-1].chunk_dims[ii] =
+				( (unsigned)rank == self->chunk_rank )? self->chunk_dims[ii] : 0;
 	}
-	self->data[self->data_size-1].name = malloc(strlen(name)+1);
-	strcpy(self->data[self->data_size-1].name, name);
-	self->data[self->data_size-1].type = type;
-	LOG_DEBUG("added writing command for data[%lu]: %s of rank %u", (unsigned long)self->data_size-1, self->data[self->data_size-1].name, (unsigned)self->data[self->data_size-1].rank);
+	list->data[list->data_size-1].compression = self->compression;
+	list->data[list->data_size-1].compression_level = self->compression_level;
+	list->data[list->data_size-1].shuffle = self->shuffle;
+	list->data[list->data_size-1].released = 0;
+	list->data[list->data_size-1].written = 0;
+	list->data[list->data_size-1].staging = NULL;
+	list->data[list->data_size-1].staged = 0;
+	list->data[list->data_size-1].staged_rows = 0;
+	list->data[list->data_size-1].space_id = -1;
+	list->data[list->data_size-1].plist_id = -1;
+	LOG_DEBUG("added writing command for data[%lu]: %s of rank %u", (unsigned long)list->data_size-1, list->data[list->data_size-1].name, (unsigned)list->data[list->data_size-1].rank);
+	/* hand the command over to the writer threads, a wake up missed because
+	 * the mutex is not held only delays the dataset creation */
+	__atomic_store_n(&(list->submitted), list->data_size, __ATOMIC_RELEASE);
+	if ( pthread_cond_signal(&(self->cond)) ) RETURN_ERROR;
+	STATS_COUNT(self, list, blocked_us, (uint64_t)(clockget()-start_time));
 	return 0;
 }
 
 
 int ah5_finish( ah5_t self )
 {
-	size_t buf_size = 0;
+	cmd_list_t* list = &(self->lists[self->fill_idx]);
+	ah5_backpressure_t outcome;
 	size_t ii;
 	void* buf;
+	int deferred_copy = self->deferred_copy;
 	int64_t start_time = clockget();
+	int64_t duration;
 	LOG_DEBUG("sealing write command list");
-	/* compute the total size of the data */
-	for ( ii = 0; ii<self->data_size; ++ii ) {
-		size_t data_size = H5Tget_size(self->data[ii].type);
+	if ( list->load ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* the unchanged Data are neither copied nor written, the writer threads
+	 * copy the commands they create the datasets of */
+	if ( self->deltas ) {
+		if ( list_claim(self, list) ) RETURN_ERROR;
+		if ( delta_check(self, list) ) {
+			int errno_save = errno;
+			list_unclaim(self, list);
+			errno = errno_save;
+			RETURN_ERROR;
+		}
+		if ( list_unclaim(self, list) ) RETURN_ERROR;
+	}
+	/* make sure the staging buffer is able to contain all the data to copy */
+	if ( staging_reserve(self, list, &outcome) ) {
+		int errno_save = errno;
+		/* drop the command list so that its slot can be reused */
+		if ( list_drop(self, list, 0) ) RETURN_ERROR;
+		errno = errno_save;
+		RETURN_ERROR;
+	}
+	if ( outcome == AH5_BACKPRESSURE_SKIP ) {
+		LOG_WARNING("memory limit reached, skipping command list for %s", list->file_name);
+		if ( list_drop(self, list, 1) ) RETURN_ERROR;
+		STATS_COUNT(self, list, lists_skipped, 1);
+		STATS_COUNT(self, list, blocked_us, (uint64_t)(clockget()-start_time));
+		if ( self->callback ) {
+			self->callback((ah5_token_t)(list->serial << TOKEN_VAR_BITS), list->file_name,
+					ECANCELED, self->callback_arg);
+		}
+		return 0;
+	}
+	if ( self->deltas && delta_commit(self, list) ) RETURN_ERROR;
+	/* the memory limit of the shared scheduler applies to all instances */
+	if ( sched_admit(self, list) ) RETURN_ERROR;
+	if ( outcome == AH5_BACKPRESSURE_DEGRADE ) STATS_COUNT(self, list, lists_degraded, 1);
+	if ( outcome == AH5_BACKPRESSURE_SPILL ) STATS_COUNT(self, list, lists_spilled, 1);
+	/* assign each Data its place in the buffer, the list is claimed until it
+	 * is sealed */
+	if ( list_claim(self, list) ) RETURN_ERROR;
+	buf = list->data_buffer.base;
+	for ( ii = 0; ii<list->data_size; ++ii ) {
+		size_t data_size = list->data[ii].type_size;
 		unsigned dim;
-		for ( dim = 0; dim < self->data[ii].rank; ++dim ) {
-			/* ubounds is just after the data, so the difference with lbound is the size */
-			data_size *= self->data[ii].ubounds[dim]-self->data[ii].lbounds[dim];
+		/* nothing to wait for */
+		if ( list->data[ii].dropped || list->data[ii].linked ) {
+			list->data[ii].staged = 1;
+			list->data[ii].released = 1;
+			continue;
 		}
-		buf_size += data_size;
+		/* the writer thread will directly access the user array */
+		if ( list->data[ii].nocopy ) {
+			list->data[ii].staged = 1;
+			continue;
+		}
+		if ( list->plan ) {
+			list->data[ii].staging = ((char*)list->data_buffer.base) + list->plan->offsets[ii];
+			continue;
+		}
+		for ( dim = 0; dim<list->data[ii].rank; ++dim ) {
+			data_size *= list->data[ii].ubounds[dim]-list->data[ii].lbounds[dim];
+		}
+		list->data[ii].staging = buf;
+		buf = ((char*)buf) + data_size;
+	}
+	list->next_copy = deferred_copy? 0 : list->data_size;
+	/* hand the command list over to the writer thread, it starts writing
+	 * each block as soon as it is staged */
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	list->state = LIST_READY;
+	list->early_busy = 0;
+	++self->nb_sealed;
+	self->fill_idx = (self->fill_idx+1) % self->nb_lists;
+	/* wake up the writer thread and the copy thread */
+	if ( pthread_cond_signal(&(self->cond)) ) RETURN_ERROR;
+	if ( deferred_copy && pthread_cond_signal(&(self->copy_cond)) ) RETURN_ERROR;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	/* copy the data into the buffer unless the copy thread does it */
+	for ( ii = 0; !deferred_copy && ii<list->data_size; ++ii ) {
+		if ( list->data[ii].staged ) continue;
+		data_stage(self, list, &(list->data[ii]), self->parallel_copy? &(self->pool) : NULL);
+	}
+	LOG_STATUS("command list finished, triggering worker thread");
+	duration = clockget()-start_time;
+	LOG_DEBUG("command list sealing duration: %" PRId64 "us", duration);
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	STATS_COUNT(self, list, blocked_us, (uint64_t)duration);
+	/* the list may have been fully written already */
+	if ( self->last_serial == list->serial ) self->last_stats.blocked_us += duration;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_plan_save( ah5_t self, ah5_plan_t* pplan )
+{
+	cmd_list_t* list = &(self->lists[self->fill_idx]);
+	ah5_plan_t plan;
+	size_t ii;
+	if ( list->state != LIST_FILLING ) {
+		errno = EINVAL;
+		RETURN_ERROR;
 	}
-	/* allocate a buffer able to contain it all */
-	self->data_buffer = realloc(self->data_buffer, buf_size);
-	/* copy the data into the bufer */
-	buf = self->data_buffer;
-	for ( ii = 0; ii<self->data_size; ++ii ) {
+	plan = malloc(sizeof(struct ah5_plan));
+	plan->data_size = list->data_size;
+	plan->data = malloc(plan->data_size*sizeof(data_id_t));
+	plan->offsets = malloc(plan->data_size*sizeof(size_t));
+	plan->buf_size = 0;
+	/* a writer thread may be creating the datasets of the list */
+	list_lock_data(list);
+	memcpy(plan->data, list->data, plan->data_size*sizeof(data_id_t));
+	list_unlock_data(list);
+	if ( h5_lock() ) RETURN_ERROR;
+	for ( ii = 0; ii<plan->data_size; ++ii ) {
+		data_id_t* data = &(plan->data[ii]);
 		size_t data_size;
 		unsigned dim;
-		int64_t start_time = clockget();
-		slicecpy(buf, self->data[ii].buf, self->data[ii].type, self->data[ii].rank, self->data[ii].dims,
-						self->data[ii].lbounds, self->data[ii].ubounds, self->parallel_copy);
-		data_size = H5Tget_size(self->data[ii].type);
-		/* since only the data has been copied, update dims, lbounds & ubounds */
-		for ( dim = 0; dim<self->data[ii].rank; ++dim ) {
-			data_size *= self->data[ii].ubounds[dim]-self->data[ii].lbounds[dim];
-			self->data[ii].dims[dim] = self->data[ii].ubounds[dim] - self->data[ii].lbounds[dim];
-			self->data[ii].ubounds[dim] -= self->data[ii].lbounds[dim];
-			self->data[ii].lbounds[dim] = 0;
-		}
-		self->data[ii].buf = buf;
+		data->buf = NULL;
+		data->released = 0;
+		data->written = 0;
+		data->dropped = 0;
+		data->name = malloc(strlen(list->data[ii].name)+1);
+		strcpy(data->name, list->data[ii].name);
+		/* the user may close the type once the plan is saved */
+		data->type = H5Tcopy(list->data[ii].type);
+		data->space_id = H5Screate_simple(data->rank, data->global_dims, NULL);
+		data->plist_id = data_plist(self, data);
+		/* the Data are staged one after the other */
+		data_size = data->type_size;
+		for ( dim = 0; dim<data->rank; ++dim ) {
+			data_size *= data->ubounds[dim]-data->lbounds[dim];
+		}
+		plan->offsets[ii] = plan->buf_size;
+		if ( !data->nocopy ) plan->buf_size += data_size;
+	}
+	if ( h5_unlock() ) RETURN_ERROR;
+	LOG_DEBUG("saved a plan of %lu write commands", (unsigned long)plan->data_size);
+	*pplan = plan;
+	return 0;
+}
+
+
+int ah5_plan_run( ah5_t self, ah5_plan_t plan, char* file_name, void** data )
+{
+	cmd_list_t* list;
+	size_t ii;
+	if ( ah5_start(self, file_name) ) RETURN_ERROR;
+	list = &(self->lists[self->fill_idx]);
+	list_reserve(list, plan->data_size);
+	memcpy(list->data, plan->data, plan->data_size*sizeof(data_id_t));
+	for ( ii = 0; ii<plan->data_size; ++ii ) {
+		list->data[ii].buf = data[ii];
+	}
+	list->data_size = plan->data_size;
+	list->plan = plan;
+	__atomic_store_n(&(list->submitted), list->data_size, __ATOMIC_RELEASE);
+	if ( ah5_finish(self) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_plan_free( ah5_t self, ah5_plan_t plan )
+{
+	size_t ii;
+	/* the plan can only be freed once no command list uses it */
+	if ( writer_thread_drain(self) ) RETURN_ERROR;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		if ( self->lists[ii].plan == plan ) list_clear(&(self->lists[ii]));
+	}
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	if ( h5_lock() ) RETURN_ERROR;
+	for ( ii = 0; ii<plan->data_size; ++ii ) {
+		if ( H5Tclose(plan->data[ii].type) ) RETURN_ERROR;
+		if ( H5Sclose(plan->data[ii].space_id) ) RETURN_ERROR;
+		if ( H5Pclose(plan->data[ii].plist_id) ) RETURN_ERROR;
+		free(plan->data[ii].name);
+	}
+	if ( h5_unlock() ) RETURN_ERROR;
+	free(plan->data);
+	free(plan->offsets);
+	free(plan);
+	return 0;
+}
+
+
+int ah5_load_start( ah5_t self, char* file_name )
+{
+	return list_start(self, file_name, 1);
+}
+
+
+int ah5_load( ah5_t self, void* data, char* name, hid_t type, int rank, hsize_t* dims,
+		hsize_t* lbounds, hsize_t* ubounds, hsize_t* offset )
+{
+	cmd_list_t* list = &(self->lists[self->fill_idx]);
+	data_id_t* load;
+	type_info_t* info;
+	hsize_t hsize_zero = 0;
+	hsize_t hsize_one = 1;
+	int64_t start_time = clockget();
+	int ii;
+	LOG_DEBUG("adding a load command to the list");
+	if ( list->state != LIST_FILLING || !list->load ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	if ( list->data_size >= MAX_COMMANDS ) {
+		LOG_ERROR("too many commands in the command list for %s", list->file_name);
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	for ( ii = 0; ii<rank; ++ii ) {
+		if ( lbounds[ii] > ubounds[ii] || ubounds[ii] > dims[ii] ) {
+			LOG_ERROR("data %s does not fit in its array in dimension %d", name, ii);
+			errno = EINVAL;
+			RETURN_ERROR;
+		}
+	}
+	list_reserve(list, list->data_size+1);
+	load = &(list->data[list->data_size++]);
+	/* scalars are read back as they are written */
+	if ( self->scalar_as_array && rank == 0 ) {
+		rank = 1;
+		dims = &hsize_one;
+		lbounds = &hsize_zero;
+		ubounds = &hsize_one;
+		offset = NULL;
+	}
+	memset(load, 0, sizeof(data_id_t));
+	load->buf = data;
+	load->rank = rank;
+	for ( ii = 0; ii<rank; ++ii ) {
+		load->dims[ii] = dims[ii];
+		load->lbounds[ii] = lbounds[ii];
+		load->ubounds[ii] = ubounds[ii];
+		load->global_dims[ii] = ubounds[ii]-lbounds[ii];
+		load->offset[ii] = offset? offset[ii] : 0;
+	}
+	load->name = list_name(list, name);
+	/* HDF5 converts the elements from the type of the dataset */
+	info = type_lookup(self, type, -1);
+	if ( !info ) RETURN_ERROR;
+	load->type = type;
+	load->type_size = info->size;
+	/* without a user array, the Data is loaded in the staging buffer */
+	load->nocopy = ( data != NULL );
+	load->essential = 1;
+	load->space_id = -1;
+	load->plist_id = -1;
+	load->dset_id = -1;
+	LOG_DEBUG("added loading command for data[%lu]: %s of rank %u", (unsigned long)list->data_size-1, load->name, (unsigned)load->rank);
+	__atomic_store_n(&(list->submitted), list->data_size, __ATOMIC_RELEASE);
+	STATS_COUNT(self, list, blocked_us, (uint64_t)(clockget()-start_time));
+	return 0;
+}
+
+
+int ah5_load_finish( ah5_t self )
+{
+	cmd_list_t* list = &(self->lists[self->fill_idx]);
+	ah5_backpressure_t outcome;
+	size_t ii;
+	void* buf;
+	int64_t start_time = clockget();
+	LOG_DEBUG("sealing load command list");
+	if ( list->state != LIST_FILLING || !list->load ) {
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	/* make sure the staging buffer is able to contain the Data loaded there */
+	if ( staging_reserve(self, list, &outcome) ) {
+		int errno_save = errno;
+		if ( list_drop(self, list, 0) ) RETURN_ERROR;
+		errno = errno_save;
+		RETURN_ERROR;
+	}
+	buf = list->data_buffer.base;
+	for ( ii = 0; ii<list->data_size; ++ii ) {
+		size_t data_size = list->data[ii].type_size;
+		unsigned dim;
+		/* the destination is always available */
+		list->data[ii].staged = 1;
+		if ( list->data[ii].nocopy ) continue;
+		for ( dim = 0; dim<list->data[ii].rank; ++dim ) {
+			data_size *= list->data[ii].ubounds[dim]-list->data[ii].lbounds[dim];
+		}
+		list->data[ii].staging = buf;
 		buf = ((char*)buf) + data_size;
-		LOG_DEBUG("copy duration: %" PRId64 "us", clockget()-start_time);
 	}
-	/* wake up the writer thread */
-	self->thread_cmd = CMD_WRITE;
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	list->state = LIST_READY;
+	++self->nb_sealed;
+	self->fill_idx = (self->fill_idx+1) % self->nb_lists;
 	if ( pthread_cond_signal(&(self->cond)) ) RETURN_ERROR;
-	LOG_STATUS("command list finished, triggering worker thread");
-	LOG_DEBUG("command list sealing duration: %" PRId64 "us", clockget()-start_time);
+	STATS_COUNT(self, list, blocked_us, (uint64_t)(clockget()-start_time));
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	LOG_STATUS("load command list finished, triggering worker thread");
+	return 0;
+}
+
+
+/** Finds the slot of a loading command list that has not been released
+ * @param self a pointer to the instance state
+ * @param token the token of the command list or of one of its Data
+ * @returns the command list, NULL if there is none
+ * @pre the instance mutex is held
+ */
+static cmd_list_t* load_find( ah5_t self, ah5_token_t token )
+{
+	uint64_t serial = ((uint64_t)token) >> TOKEN_VAR_BITS;
+	size_t ii;
+	for ( ii = 0; ii<self->nb_lists; ++ii ) {
+		cmd_list_t* list = &(self->lists[ii]);
+		if ( list->serial == serial && list->load && list->state != LIST_FREE ) return list;
+	}
+	return NULL;
+}
+
+
+int ah5_load_data( ah5_t self, ah5_token_t token, void** data )
+{
+	size_t var = ((uint64_t)token) & ((UINT64_C(1)<<TOKEN_VAR_BITS)-1);
+	cmd_list_t* list;
+	if ( ah5_token_wait(self, token) ) RETURN_ERROR;
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	list = load_find(self, token);
+	if ( !list || var == 0 || var > list->data_size ) {
+		if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+		errno = EINVAL;
+		RETURN_ERROR;
+	}
+	*data = list->data[var-1].staging? list->data[var-1].staging : list->data[var-1].buf;
+	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
+	return 0;
+}
+
+
+int ah5_load_release( ah5_t self, ah5_token_t token )
+{
+	cmd_list_t* list;
+	/* the list must be fully loaded first */
+	token = (ah5_token_t)((((uint64_t)token) >> TOKEN_VAR_BITS) << TOKEN_VAR_BITS);
+	if ( ah5_token_wait(self, token) ) RETURN_ERROR;
+	if ( pthread_mutex_lock(&(self->mutex)) ) RETURN_ERROR;
+	list = load_find(self, token);
+	if ( list && list->state == LIST_LOADED ) {
+		LOG_DEBUG("releasing loaded command list");
+		list->state = LIST_FREE;
+		if ( pthread_cond_broadcast(&(self->free_cond)) ) RETURN_ERROR;
+	}
 	if ( pthread_mutex_unlock(&(self->mutex)) ) RETURN_ERROR;
 	return 0;
 }